@@ -3,8 +3,17 @@
 #include <fstream>
 #include <vector>
 #include <random>
+#include <sstream>
+#include <cstring>
+#include <cassert>
 #include <algorithm>
 #include <Eigen/Dense>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 namespace MyDL
 {
@@ -30,18 +39,81 @@ namespace MyDL
         return ((int)c1 << 24) + ((int)c2 << 16) + ((int)c3 << 8) + ((int)c4);
     }
 
+    // 状態保存用のバイト列読み書き
+    namespace
+    {
+        const char STATE_MAGIC[4] = {'M', 'N', 'L', 'S'};
+        const int STATE_VERSION = 1;
+
+        template <typename T>
+        void append_value(vector<char> &blob, const T &value)
+        {
+            const char *p = (const char *)&value;
+            blob.insert(blob.end(), p, p + sizeof(T));
+        }
+
+        template <typename T>
+        bool read_value(const vector<char> &blob, size_t &pos, T &value)
+        {
+            if (pos + sizeof(T) > blob.size())
+            {
+                return false;
+            }
+            std::memcpy(&value, blob.data() + pos, sizeof(T));
+            pos += sizeof(T);
+            return true;
+        }
+
+        void append_indices(vector<char> &blob, const vector<int> &indices)
+        {
+            append_value(blob, (int)indices.size());
+            const char *p = (const char *)indices.data();
+            blob.insert(blob.end(), p, p + indices.size() * sizeof(int));
+        }
+
+        bool read_indices(const vector<char> &blob, size_t &pos, vector<int> &indices, int max_index)
+        {
+            int size;
+            if (!read_value(blob, pos, size) || size < 0 || pos + (size_t)size * sizeof(int) > blob.size())
+            {
+                return false;
+            }
+            indices.resize(size);
+            std::memcpy(indices.data(), blob.data() + pos, (size_t)size * sizeof(int));
+            pos += (size_t)size * sizeof(int);
+
+            for (int idx : indices)
+            {
+                if (idx < 0 || idx >= max_index)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
     // ------------------------------------------------------
     //              Eigen用 MNISTローダ 実装
     // ------------------------------------------------------
 
-    // コンストラクタ
-    MnistEigenDataset::MnistEigenDataset(int batch_size, bool random_load)
+    // コンストラクタ(メモリ予算0：従来通り1枚ずつファイルをシークして読み出す)
+    MnistEigenDataset::MnistEigenDataset(int batch_size, bool random_load, unsigned long long seed)
+        : MnistEigenDataset(batch_size, LoaderMemoryBudget(0), random_load, seed)
+    {
+    }
+
+    // コンストラクタ(メモリ予算から読み出し方式を自動選択)
+    MnistEigenDataset::MnistEigenDataset(int batch_size, LoaderMemoryBudget budget, bool random_load, unsigned long long seed)
     {
         _batch_size = batch_size;
+        _random_load = random_load;
+        _rng.seed(seed);
 
         // ファイル読み込み初期化処理
         _init_train_loader();
         _init_test_loader();
+        _select_backend(budget.bytes);
 
         _train_max_batch_num = (_number_of_train_data + _batch_size - 1) / _batch_size; // 切り上げ
         _test_max_batch_num = (_number_of_test_data + _batch_size - 1) / _batch_size;
@@ -49,141 +121,272 @@ namespace MyDL
         // ランダム読み出しの設定をしているときはインデックスをシャッフル
         if (random_load)
         {
-            std::mt19937_64 get_rand_mt;
-            std::shuffle(_train_indices.begin(), _train_indices.end(), get_rand_mt);
-            std::shuffle(_test_indices.begin(), _test_indices.end(), get_rand_mt);
+            _shuffle_indices(_train_indices);
+            _shuffle_indices(_test_indices);
         }
     }
 
-
-    void MnistEigenDataset::next_train(MatrixXd &train_X, MatrixXd &train_y, bool one_hot_label, bool normalize)
+    MnistEigenDataset::~MnistEigenDataset()
     {
-        // 読み出し用一時変数
-        int pixels = _rows * _cols;
-        vector<double> tmp_image(pixels); // 配列のサイズ初期化が必要(でないとセグフォ)
-        vector<double> tmp_labels(_batch_size);
+#if defined(__unix__) || defined(__APPLE__)
+        for (SampleSource *src : {&_train_source, &_test_source})
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                if (src->map_addr[k] != nullptr)
+                {
+                    munmap(src->map_addr[k], src->map_len[k]);
+                }
+            }
+        }
+#endif
+    }
 
-        if (one_hot_label)
+    string MnistEigenDataset::backend_name(void) const
+    {
+        switch (_backend)
         {
-            train_y = MatrixXd::Zero(_batch_size, 10); // one_hot_label有効化時の初期化
+        case LoaderBackend::InMemory:
+            return "in-memory";
+        case LoaderBackend::Mmap:
+            return "mmap";
+        default:
+            return "streaming";
         }
+    }
 
+
+    template <typename ImageType, typename MatrixType>
+    void MnistEigenDataset::next_train(ImageType &train_X, MatrixType &train_y, bool one_hot_label, bool normalize)
+    {
         // インデックス取得：初期位置計算
         int start_idx = _batch_size * _train_load_count;
-        int tmp_idx;
-        // ここに必要なだけ訓練データを読み出す処理を作成
-        for (int i = 0; i < _batch_size; i++)
-        {
-            // 59999を超えたインデックスは0から再カウント
-            tmp_idx = _train_indices[(start_idx + i) % _number_of_train_data];
+        _load_batch(true, _train_source, _train_indices, start_idx, _batch_size, train_X, train_y, one_hot_label, normalize);
 
-            // ファイルシーク：画像データのインターバルは「28×28=784byte」あるので注意
-            // 画像データ
-            _train_image_ifs.seekg(_train_image_pos);                     // シークを初期位置に
-            _train_image_ifs.seekg(tmp_idx * pixels, std::ios_base::cur); // 読み出し位置まで移動
-            // ラベル
-            _train_label_ifs.seekg(_train_label_pos);                     // シークを初期位置に
-            _train_label_ifs.seekg(tmp_idx, std::ios_base::cur);          // 読み出し位置まで移動
+        _train_load_count++;
+        // カウンタリセット → バッチ数とカウントが同じになったら0にする
+        _train_load_count = _train_load_count % _train_max_batch_num;
 
-            // 画像読み出し
-            for (int j = 0; j < pixels; j++)
+        // 1エポック読み終えたら、ランダム読み出し時は次のエポック用にシャッフルし直す
+        if (_train_load_count == 0)
+        {
+            _train_epoch++;
+            if (_random_load)
             {
-                unsigned char tmp_value;
-                _train_image_ifs.read((char *)&tmp_value, sizeof(tmp_value));
-                tmp_image[j] = (double)(tmp_value);
+                _shuffle_indices(_train_indices);
             }
+        }
+    }
 
-            train_X.row(i) = Map<Matrix<double, 1, 28 * 28>>(&(tmp_image[0]));
 
-            // ラベル読み出し
-            unsigned char tmp_label;
-            _train_label_ifs.read((char *)&tmp_label, sizeof(tmp_label));
-            tmp_labels[i] = (double)(tmp_label);
+    template <typename ImageType, typename MatrixType>
+    void MnistEigenDataset::next_test(ImageType &test_X, MatrixType &test_y, bool one_hot_label, bool normalize)
+    {
+        // インデックス取得：初期位置計算
+        int start_idx = _batch_size * _test_load_count;
+        _load_batch(false, _test_source, _test_indices, start_idx, _batch_size, test_X, test_y, one_hot_label, normalize);
 
-            // one-hotか否かで場合分け
-            if (one_hot_label)
-            {
-                train_y(i, int(tmp_label)) = 1;
-            }
-            else
-            {
-                train_y.row(i) = Map<Matrix<double, 1, 1>>(&(tmp_labels[i]));
-            }
+        _test_load_count++;
+        // カウンタリセット → バッチ数とカウントが同じになったら0にする
+        _test_load_count = _test_load_count % _test_max_batch_num;
+    }
+
+    template void MnistEigenDataset::next_train<MatrixXd>(MatrixXd &, MatrixXd &, bool, bool);
+    template void MnistEigenDataset::next_train<MatrixXf>(MatrixXf &, MatrixXf &, bool, bool);
+    template void MnistEigenDataset::next_train<SparseImageBatchXd>(SparseImageBatchXd &, MatrixXd &, bool, bool);
+    template void MnistEigenDataset::next_train<SparseImageBatchXf>(SparseImageBatchXf &, MatrixXf &, bool, bool);
+    template void MnistEigenDataset::next_test<MatrixXd>(MatrixXd &, MatrixXd &, bool, bool);
+    template void MnistEigenDataset::next_test<MatrixXf>(MatrixXf &, MatrixXf &, bool, bool);
+    template void MnistEigenDataset::next_test<SparseImageBatchXd>(SparseImageBatchXd &, MatrixXd &, bool, bool);
+    template void MnistEigenDataset::next_test<SparseImageBatchXf>(SparseImageBatchXf &, MatrixXf &, bool, bool);
+
+    // 読み出し位置の保存：途中のエポックから同じ順番で再開できるようにする
+    vector<char> MnistEigenDataset::save_state(void) const
+    {
+        vector<char> blob;
+        save_state(blob);
+        return blob;
+    }
+
+    void MnistEigenDataset::save_state(vector<char> &blob) const
+    {
+        blob.assign(STATE_MAGIC, STATE_MAGIC + 4);
+        append_value(blob, STATE_VERSION);
+        append_value(blob, _batch_size);
+        append_value(blob, _train_epoch);
+        append_value(blob, _train_load_count);
+        append_value(blob, _test_load_count);
+
+        // 乱数生成器の内部状態はテキスト形式でしか取り出せないので、長さ付きで格納
+        std::ostringstream oss;
+        oss << _rng;
+        string rng_state = oss.str();
+        append_value(blob, (int)rng_state.size());
+        blob.insert(blob.end(), rng_state.begin(), rng_state.end());
+
+        append_indices(blob, _train_indices);
+        append_indices(blob, _test_indices);
+    }
+
+    // 読み出し位置の復元
+    bool MnistEigenDataset::load_state(const vector<char> &blob)
+    {
+        size_t pos = 4;
+        int version, batch_size, epoch, train_load_count, test_load_count, rng_state_size;
+
+        if (blob.size() < 4 || !std::equal(STATE_MAGIC, STATE_MAGIC + 4, blob.begin()))
+        {
+            return false;
+        }
+        if (!read_value(blob, pos, version) || version != STATE_VERSION ||
+            !read_value(blob, pos, batch_size) || batch_size != _batch_size ||
+            !read_value(blob, pos, epoch) || epoch < 0 ||
+            !read_value(blob, pos, train_load_count) || train_load_count < 0 ||
+            !read_value(blob, pos, test_load_count) || test_load_count < 0 ||
+            !read_value(blob, pos, rng_state_size) || rng_state_size < 0 || pos + rng_state_size > blob.size())
+        {
+            return false;
         }
 
-        if (normalize)
+        std::mt19937_64 rng;
+        std::istringstream iss(string(blob.data() + pos, rng_state_size));
+        iss >> rng;
+        pos += rng_state_size;
+
+        vector<int> train_indices, test_indices;
+        if (iss.fail() ||
+            !read_indices(blob, pos, train_indices, _number_of_train_data) || train_indices.empty() ||
+            !read_indices(blob, pos, test_indices, _number_of_test_data) || test_indices.empty())
         {
-            train_X /= 255;
+            return false;
         }
 
-        _train_load_count++;
-        // カウンタリセット → バッチ数とカウントが同じになったら0にする
-        _train_load_count = _train_load_count % _train_max_batch_num;
+        // ここまで読めたら反映
+        _train_indices.swap(train_indices);
+        _test_indices.swap(test_indices);
+        _train_max_batch_num = ((int)_train_indices.size() + _batch_size - 1) / _batch_size;
+        _test_max_batch_num = ((int)_test_indices.size() + _batch_size - 1) / _batch_size;
+        _train_epoch = epoch;
+        _train_load_count = train_load_count % _train_max_batch_num;
+        _test_load_count = test_load_count % _test_max_batch_num;
+        _rng = rng;
+        return true;
     }
 
+    // 訓練データの一部を検証用として切り出す(ファイル上のインデックス範囲 [begin, end) を指定)
+    // 範囲が [0, 訓練データ数] を外れる・begin > end の場合は空のビューを返す(訓練データは変更しない)
+    MnistSubsetView MnistEigenDataset::split_validation_range(int begin, int end)
+    {
+        vector<int> valid_indices;
+        if (begin < 0 || end > _number_of_train_data || begin > end)
+        {
+            return MnistSubsetView(this, valid_indices, _batch_size);
+        }
+        for (int i = begin; i < end; i++)
+        {
+            valid_indices.push_back(i);
+        }
+        return _split_train(valid_indices);
+    }
 
-    void MnistEigenDataset::next_test(MatrixXd &test_X, MatrixXd &test_y, bool one_hot_label, bool normalize)
+    // 訓練データの一部を検証用として切り出す(ラベルごとに fraction の割合だけ層化抽出)
+    // fraction が [0, 1] を外れる(NaNを含む)場合は空のビューを返す(訓練データは変更しない)
+    MnistSubsetView MnistEigenDataset::split_validation_stratified(double fraction, unsigned int seed)
     {
+        if (!(fraction >= 0.0 && fraction <= 1.0))
+        {
+            return MnistSubsetView(this, vector<int>(), _batch_size);
+        }
 
-        // 読み出し用一時変数
-        int pixels = _rows * _cols;
-        vector<double> tmp_image(pixels);
-        vector<double> tmp_labels(_batch_size);
+        // ラベルごとにインデックスを振り分け
+        vector<vector<int>> indices_per_label(10);
+        for (int i = 0; i < _number_of_train_data; i++)
+        {
+            indices_per_label[_read_label(true, &_subset_source, i)].push_back(i); // 先頭から順に読むのでブロック単位で読む
+        }
 
-        if (one_hot_label)
+        std::mt19937_64 get_rand_mt(seed);
+        vector<int> valid_indices;
+        for (auto &indices : indices_per_label)
         {
-            test_y = MatrixXd::Zero(_batch_size, 10);
+            std::shuffle(indices.begin(), indices.end(), get_rand_mt);
+            int count = (int)(indices.size() * fraction + 0.5);
+            valid_indices.insert(valid_indices.end(), indices.begin(), indices.begin() + count);
         }
+        std::shuffle(valid_indices.begin(), valid_indices.end(), get_rand_mt);
 
-        // インデックス取得：初期位置計算
-        int start_idx = _batch_size * _test_load_count;
-        int tmp_idx;
-        // ここに必要なだけ訓練データを読み出す処理を作成
-        for (int i = 0; i < _batch_size; i++)
+        return _split_train(valid_indices);
+    }
+
+    // 全データ一括ビュー：初回のみファイルから一括読み出しして保持、以降はMapを返すだけ
+    Map<const ImageMatrixXf> MnistEigenDataset::train_images(void)
+    {
+        if (_train_images_full.size() == 0)
         {
-            // 59999を超えたインデックスは0から再カウント
-            tmp_idx = _test_indices[(start_idx + i) % (_number_of_test_data)];
-            // ファイルシーク：画像データのインターバルは「28×28=784byte」あるので注意
-            // 画像データ
-            _test_image_ifs.seekg(_test_image_pos);                      // シークを初期位置に
-            _test_image_ifs.seekg(tmp_idx * pixels, std::ios_base::cur); // 読み出し位置まで移動
-            // ラベル
-            _test_label_ifs.seekg(_test_label_pos);                      // シークを初期位置に
-            _test_label_ifs.seekg(tmp_idx, std::ios_base::cur);          // 読み出し位置まで移動
+            _load_full(_train_image_ifs, _train_image_pos, _train_label_ifs, _train_label_pos,
+                       _number_of_train_data, _train_images_full, _train_labels_full);
+        }
+        return Map<const ImageMatrixXf>(_train_images_full.data(), _train_images_full.rows(), _train_images_full.cols());
+    }
 
-            // 画像読み出し
-            for (int j = 0; j < pixels; j++)
-            {
-                unsigned char tmp_value;
-                _test_image_ifs.read((char *)&tmp_value, sizeof(tmp_value));
-                tmp_image[j] = (double)(tmp_value);
-            }
-            test_X.row(i) = Map<Matrix<double, 1, 28 * 28>>(&(tmp_image[0]));
+    Map<const LabelVectorXi> MnistEigenDataset::train_labels(void)
+    {
+        if (_train_images_full.size() == 0)
+        {
+            _load_full(_train_image_ifs, _train_image_pos, _train_label_ifs, _train_label_pos,
+                       _number_of_train_data, _train_images_full, _train_labels_full);
+        }
+        return Map<const LabelVectorXi>(_train_labels_full.data(), _train_labels_full.size());
+    }
 
-            // ラベル読み出し
-            unsigned char tmp_label;
-            _test_label_ifs.read((char *)&tmp_label, sizeof(tmp_label));
-            tmp_labels[i] = (double)(tmp_label);
+    Map<const ImageMatrixXf> MnistEigenDataset::test_images(void)
+    {
+        if (_test_images_full.size() == 0)
+        {
+            _load_full(_test_image_ifs, _test_image_pos, _test_label_ifs, _test_label_pos,
+                       _number_of_test_data, _test_images_full, _test_labels_full);
+        }
+        return Map<const ImageMatrixXf>(_test_images_full.data(), _test_images_full.rows(), _test_images_full.cols());
+    }
 
-            // one-hotか否かで場合分け
-            if (one_hot_label)
-            {
-                test_y(i, int(tmp_label)) = 1;
-            }
-            else
-            {
-                test_y.row(i) = Map<Matrix<double, 1, 1>>(&(tmp_labels[i]));
-            }
+    Map<const LabelVectorXi> MnistEigenDataset::test_labels(void)
+    {
+        if (_test_images_full.size() == 0)
+        {
+            _load_full(_test_image_ifs, _test_image_pos, _test_label_ifs, _test_label_pos,
+                       _number_of_test_data, _test_images_full, _test_labels_full);
         }
+        return Map<const LabelVectorXi>(_test_labels_full.data(), _test_labels_full.size());
+    }
 
-        if (normalize)
+    // 生の画素値ビュー：InMemory / Mmap は読み出し元の先頭画像から連続して並んでいるのでそのまま返す
+    Map<const ImageMatrixXu8> MnistEigenDataset::_raw_images(const SampleSource &src, ifstream &image_ifs, ifstream::pos_type image_pos,
+                                                             int number_of_data, vector<unsigned char> &holder)
+    {
+        int pixels = _rows * _cols;
+        if (_backend != LoaderBackend::Streaming && src.images != nullptr)
         {
-            test_X /= 255;
+            return Map<const ImageMatrixXu8>(src.images, number_of_data, pixels);
         }
 
-        _test_load_count++;
-        // カウンタリセット → バッチ数とカウントが同じになったら0にする
-        _test_load_count = _test_load_count % _test_max_batch_num;
+        if (holder.empty())
+        {
+            holder.resize((size_t)number_of_data * pixels);
+            image_ifs.clear();
+            image_ifs.seekg(image_pos);
+            image_ifs.read((char *)holder.data(), holder.size());
+        }
+        return Map<const ImageMatrixXu8>(holder.data(), number_of_data, pixels);
+    }
+
+    Map<const ImageMatrixXu8> MnistEigenDataset::train_images_raw(void)
+    {
+        return _raw_images(_train_source, _train_image_ifs, _train_image_pos, _number_of_train_data, _train_images_raw);
+    }
+
+    Map<const ImageMatrixXu8> MnistEigenDataset::test_images_raw(void)
+    {
+        return _raw_images(_test_source, _test_image_ifs, _test_image_pos, _number_of_test_data, _test_images_raw);
     }
 
     // ファイルパス setter
@@ -217,6 +420,414 @@ namespace MyDL
     // -------------------------------------------------------------
     //                   内部メソッド
     // -------------------------------------------------------------
+
+    // バッチの画像の書き込み先：密行列(呼び出し側で確保済み)と CSR 形式
+    namespace
+    {
+        template <typename MatrixType>
+        void begin_images(MatrixType &, int) {}
+
+        template <typename Scalar>
+        void begin_images(SparseImageBatch<Scalar> &X, int pixels)
+        {
+            X.clear(pixels);
+        }
+
+        template <typename MatrixType>
+        void store_image(MatrixType &X, int i, const unsigned char *image, int pixels)
+        {
+            typedef typename MatrixType::Scalar Scalar;
+            X.row(i) = Map<const Matrix<unsigned char, 1, Dynamic>>(image, pixels).template cast<Scalar>();
+        }
+
+        template <typename Scalar>
+        void store_image(SparseImageBatch<Scalar> &X, int, const unsigned char *image, int)
+        {
+            X.append_row(image);
+        }
+
+        template <typename MatrixType>
+        void normalize_images(MatrixType &X)
+        {
+            X /= 255;
+        }
+
+        template <typename Scalar>
+        void normalize_images(SparseImageBatch<Scalar> &X)
+        {
+            for (Scalar &value : X.values)
+            {
+                value /= 255;
+            }
+        }
+    }
+
+    // indices[start_idx] から batch_size 件分を読み出してバッチを作る(末尾を超えた分は先頭から)
+    // Streaming では stream_buffer をシャッフルバッファに使う。バッファに載っていないサンプルは、
+    // 次に読むサンプルも同じブロックにあるときだけブロックごと読み込み、それ以外(ブロックをまたいで飛び飛びに読む順番)は1枚ずつ読む
+    template <typename ImageType, typename MatrixType>
+    void MnistEigenDataset::_load_batch(bool is_train, SampleSource &stream_buffer, const vector<int> &indices, int start_idx, int batch_size,
+                                        ImageType &X, MatrixType &y, bool one_hot_label, bool normalize)
+    {
+        typedef typename MatrixType::Scalar Scalar;
+        assert(!indices.empty());
+
+        // 読み出し用一時変数
+        int pixels = _rows * _cols;
+        vector<unsigned char> tmp_image(pixels);
+        begin_images(X, pixels);
+
+        if (one_hot_label)
+        {
+            y = MatrixType::Zero(batch_size, 10); // one_hot_label有効化時の初期化
+        }
+
+        for (int i = 0; i < batch_size; i++)
+        {
+            int tmp_idx = indices[(start_idx + i) % indices.size()];
+            SampleSource *block = nullptr;
+            if (_backend == LoaderBackend::Streaming && _stream_block_size > 1)
+            {
+                int next_idx = indices[(start_idx + i + 1) % indices.size()];
+                int tmp_block = tmp_idx / _stream_block_size;
+                if (stream_buffer.block_begin == tmp_block * _stream_block_size || next_idx / _stream_block_size == tmp_block)
+                {
+                    block = &stream_buffer;
+                }
+            }
+
+            // 画像読み出し
+            _read_image(is_train, block, tmp_idx, tmp_image.data());
+            store_image(X, i, tmp_image.data(), pixels);
+
+            // ラベル読み出し：one-hotか否かで場合分け
+            unsigned char tmp_label = _read_label(is_train, block, tmp_idx);
+            if (one_hot_label)
+            {
+                y(i, int(tmp_label)) = 1;
+            }
+            else
+            {
+                y(i, 0) = (Scalar)(tmp_label);
+            }
+        }
+
+        if (normalize)
+        {
+            normalize_images(X);
+        }
+    }
+
+    // 画像1枚(rows×cols byte)を読み出す
+    // Streaming では block(シャッフルバッファ)を渡した場合は idx を含むブロックを載せてから、nullptr なら1枚だけファイルから読む
+    void MnistEigenDataset::_read_image(bool is_train, SampleSource *block, int idx, unsigned char *dst)
+    {
+        SampleSource &src = is_train ? _train_source : _test_source;
+        int pixels = _rows * _cols;
+
+        if (_backend == LoaderBackend::InMemory || _backend == LoaderBackend::Mmap)
+        {
+            std::memcpy(dst, src.images + (size_t)idx * pixels, pixels);
+        }
+        else if (block != nullptr && _stream_block_size > 1)
+        {
+            _fill_stream_block(is_train, *block, idx);
+            std::memcpy(dst, block->image_bytes.data() + (size_t)(idx - block->block_begin) * pixels, pixels);
+        }
+        else
+        {
+            ifstream &ifs = is_train ? _train_image_ifs : _test_image_ifs;
+
+            // ファイルシーク：画像データのインターバルは「28×28=784byte」あるので注意
+            ifs.clear();
+            ifs.seekg(is_train ? _train_image_pos : _test_image_pos); // シークを初期位置に
+            ifs.seekg((std::streamoff)idx * pixels, std::ios_base::cur); // 読み出し位置まで移動
+            ifs.read((char *)dst, pixels);
+        }
+    }
+
+    // ラベル1件を読み出す
+    unsigned char MnistEigenDataset::_read_label(bool is_train, SampleSource *block, int idx)
+    {
+        SampleSource &src = is_train ? _train_source : _test_source;
+
+        if (_backend != LoaderBackend::Streaming)
+        {
+            return src.labels[idx];
+        }
+        if (block != nullptr && _stream_block_size > 1)
+        {
+            _fill_stream_block(is_train, *block, idx);
+            return block->label_bytes[idx - block->block_begin];
+        }
+
+        ifstream &ifs = is_train ? _train_label_ifs : _test_label_ifs;
+        unsigned char label;
+
+        ifs.clear();
+        ifs.seekg(is_train ? _train_label_pos : _test_label_pos);
+        ifs.seekg(idx, std::ios_base::cur);
+        ifs.read((char *)&label, sizeof(label));
+        return label;
+    }
+
+    // Streaming：idx を含むブロック(_stream_block_size 枚)を src のバッファにまとめて連続読み出しする
+    void MnistEigenDataset::_fill_stream_block(bool is_train, SampleSource &src, int idx)
+    {
+        int begin = idx / _stream_block_size * _stream_block_size;
+        if (src.block_begin == begin)
+        {
+            return;
+        }
+
+        int pixels = _rows * _cols;
+        int count = std::min(_stream_block_size, (is_train ? _number_of_train_data : _number_of_test_data) - begin);
+        ifstream &image_ifs = is_train ? _train_image_ifs : _test_image_ifs;
+        ifstream &label_ifs = is_train ? _train_label_ifs : _test_label_ifs;
+
+        src.image_bytes.resize((size_t)_stream_block_size * pixels);
+        src.label_bytes.resize(_stream_block_size);
+
+        image_ifs.clear();
+        image_ifs.seekg(is_train ? _train_image_pos : _test_image_pos);
+        image_ifs.seekg((std::streamoff)begin * pixels, std::ios_base::cur);
+        image_ifs.read((char *)src.image_bytes.data(), (std::streamsize)count * pixels);
+
+        label_ifs.clear();
+        label_ifs.seekg(is_train ? _train_label_pos : _test_label_pos);
+        label_ifs.seekg(begin, std::ios_base::cur);
+        label_ifs.read((char *)src.label_bytes.data(), count);
+
+        src.block_begin = begin;
+    }
+
+    // インデックスのシャッフル
+    // Streaming(バッファあり)のときは、ファイル上で連続したブロック単位で順番を入れ替え、
+    // ブロック内だけを細かくシャッフルする(シャッフルバッファ方式：ファイルは連続読み出しで済む)
+    void MnistEigenDataset::_shuffle_indices(vector<int> &indices)
+    {
+        if (_backend != LoaderBackend::Streaming || _stream_block_size <= 1)
+        {
+            std::shuffle(indices.begin(), indices.end(), _rng);
+            return;
+        }
+
+        std::sort(indices.begin(), indices.end());
+
+        // ブロックごとの [開始, 終了) 位置
+        vector<std::pair<int, int>> blocks;
+        for (int i = 0; i < (int)indices.size(); i++)
+        {
+            if (i == 0 || indices[i] / _stream_block_size != indices[i - 1] / _stream_block_size)
+            {
+                blocks.push_back({i, i});
+            }
+            blocks.back().second = i + 1;
+        }
+        std::shuffle(blocks.begin(), blocks.end(), _rng);
+
+        vector<int> shuffled;
+        shuffled.reserve(indices.size());
+        for (auto &block : blocks)
+        {
+            auto begin = shuffled.end() - shuffled.begin();
+            shuffled.insert(shuffled.end(), indices.begin() + block.first, indices.begin() + block.second);
+            std::shuffle(shuffled.begin() + begin, shuffled.end(), _rng);
+        }
+        indices.swap(shuffled);
+    }
+
+    // メモリ予算とIDXヘッダのデータ数から読み出し方式を選ぶ
+    //   全データが予算に収まる               → InMemory
+    //   数バッチ分の予算がある               → Mmap(マップした領域から直接読み出す)
+    //   それ以外(mmapが使えない場合も)       → Streaming(予算分をシャッフルバッファに)
+    void MnistEigenDataset::_select_backend(size_t budget)
+    {
+        int pixels = _rows * _cols;
+        size_t sample_bytes = pixels + 1;
+        size_t total_bytes = ((size_t)_number_of_train_data + _number_of_test_data) * sample_bytes;
+        size_t min_mmap_bytes = (size_t)8 * _batch_size * sample_bytes;
+
+        if (budget > 0 && budget >= total_bytes)
+        {
+            _backend = LoaderBackend::InMemory;
+            _read_source(_train_source, _train_image_ifs, _train_image_pos, _train_label_ifs, _train_label_pos, _number_of_train_data);
+            _read_source(_test_source, _test_image_ifs, _test_image_pos, _test_label_ifs, _test_label_pos, _number_of_test_data);
+            cout << "LOADER backend: " << backend_name() << " (" << total_bytes << " bytes)" << endl;
+        }
+        else if (budget >= min_mmap_bytes &&
+                 _map_source(_train_source, _train_image_filepath, _train_image_pos, _train_label_filepath, _train_label_pos) &&
+                 _map_source(_test_source, _test_image_filepath, _test_image_pos, _test_label_filepath, _test_label_pos))
+        {
+            _backend = LoaderBackend::Mmap;
+            cout << "LOADER backend: " << backend_name() << endl;
+        }
+        else
+        {
+            _backend = LoaderBackend::Streaming;
+            // 訓練・テスト・部分集合ビュー(検証用など)のバッファで3等分(int に収まるよう、データ数で頭打ち)
+            size_t block_size = budget / 3 / sample_bytes;
+            block_size = std::min<size_t>(block_size, std::max(_number_of_train_data, _number_of_test_data));
+            _stream_block_size = (int)std::max<size_t>(1, block_size);
+            cout << "LOADER backend: " << backend_name() << " (shuffle buffer: " << _stream_block_size << " samples)" << endl;
+        }
+    }
+
+    // InMemory：画像・ラベルファイルの中身をすべて読み込む
+    void MnistEigenDataset::_read_source(SampleSource &src, ifstream &image_ifs, ifstream::pos_type image_pos,
+                                         ifstream &label_ifs, ifstream::pos_type label_pos, int number_of_data)
+    {
+        src.image_bytes.resize((size_t)number_of_data * _rows * _cols);
+        src.label_bytes.resize(number_of_data);
+
+        image_ifs.clear();
+        image_ifs.seekg(image_pos);
+        image_ifs.read((char *)src.image_bytes.data(), src.image_bytes.size());
+        label_ifs.clear();
+        label_ifs.seekg(label_pos);
+        label_ifs.read((char *)src.label_bytes.data(), src.label_bytes.size());
+
+        src.images = src.image_bytes.data();
+        src.labels = src.label_bytes.data();
+    }
+
+    // Mmap：画像・ラベルファイルを読み出し専用でmmapする(失敗したらfalse)
+    bool MnistEigenDataset::_map_source(SampleSource &src, const string &image_filepath, ifstream::pos_type image_pos,
+                                        const string &label_filepath, ifstream::pos_type label_pos)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const string *filepaths[2] = {&image_filepath, &label_filepath};
+
+        for (int k = 0; k < 2; k++)
+        {
+            int fd = open(filepaths[k]->c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                return false;
+            }
+            struct stat st;
+            void *addr = MAP_FAILED;
+            if (fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            close(fd);
+            if (addr == MAP_FAILED)
+            {
+                return false;
+            }
+            src.map_addr[k] = addr;
+            src.map_len[k] = st.st_size;
+
+            // ランダム読み出し時は先読みを抑制
+            if (_random_load)
+            {
+                madvise(addr, st.st_size, MADV_RANDOM);
+            }
+        }
+
+        src.images = (const unsigned char *)src.map_addr[0] + (std::streamoff)image_pos;
+        src.labels = (const unsigned char *)src.map_addr[1] + (std::streamoff)label_pos;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // 検証用インデックスを訓練データの読み出し対象から外し、検証用ビューを作る
+    // (既に切り出し済みのインデックスは除く)。検証用・訓練用のどちらかが空になる場合は
+    // 空のビューを返し、訓練データは変更しない(空のままだとバッチ数が0になり next_train が読めない)
+    MnistSubsetView MnistEigenDataset::_split_train(const vector<int> &candidate_indices)
+    {
+        vector<bool> is_train(_number_of_train_data, false);
+        for (int idx : _train_indices)
+        {
+            is_train[idx] = true;
+        }
+        vector<bool> is_valid(_number_of_train_data, false);
+        vector<int> valid_indices;
+        for (int idx : candidate_indices)
+        {
+            if (is_train[idx] && !is_valid[idx])
+            {
+                is_valid[idx] = true;
+                valid_indices.push_back(idx);
+            }
+        }
+        if (valid_indices.empty() || valid_indices.size() == _train_indices.size())
+        {
+            return MnistSubsetView(this, vector<int>(), _batch_size);
+        }
+
+        _train_indices.erase(std::remove_if(_train_indices.begin(), _train_indices.end(),
+                                            [&](int idx) { return is_valid[idx]; }),
+                             _train_indices.end());
+
+        // 訓練データの件数が変わるのでバッチ数を計算し直し、先頭から読み直す
+        _train_max_batch_num = ((int)_train_indices.size() + _batch_size - 1) / _batch_size;
+        _train_load_count = 0;
+
+        // Streaming(バッファあり)では、ビューの読み出し順をファイル上のブロック順にそろえる
+        // (ブロック内の順番はそのまま。ブロックごとに1回の連続読み出しで済む)
+        if (_backend == LoaderBackend::Streaming && _stream_block_size > 1)
+        {
+            std::stable_sort(valid_indices.begin(), valid_indices.end(),
+                             [&](int a, int b) { return a / _stream_block_size < b / _stream_block_size; });
+        }
+
+        return MnistSubsetView(this, valid_indices, _batch_size);
+    }
+
+    // ------------------------------------------------------
+    //        訓練データの部分集合ビュー 実装
+    // ------------------------------------------------------
+    MnistSubsetView::MnistSubsetView(MnistEigenDataset *dataset, const vector<int> &indices, int batch_size)
+        : _dataset(dataset), _indices(indices), _batch_size(batch_size)
+    {
+        _max_batch_num = ((int)_indices.size() + _batch_size - 1) / _batch_size;
+    }
+
+    template <typename MatrixType>
+    void MnistSubsetView::next(MatrixType &X, MatrixType &y, bool one_hot_label, bool normalize)
+    {
+        // 切り出しに失敗した空のビューからは読み出さない
+        if (_indices.empty())
+        {
+            return;
+        }
+        _dataset->_load_batch(true, _dataset->_subset_source, _indices, _batch_size * _load_count, _batch_size, X, y, one_hot_label, normalize);
+
+        _load_count++;
+        _load_count = _load_count % _max_batch_num;
+    }
+
+    template void MnistSubsetView::next<MatrixXd>(MatrixXd &, MatrixXd &, bool, bool);
+    template void MnistSubsetView::next<MatrixXf>(MatrixXf &, MatrixXf &, bool, bool);
+
+
+    // 画像・ラベルを一括で読み出し、正規化済みfloat行列として保持する
+    void MnistEigenDataset::_load_full(ifstream &image_ifs, ifstream::pos_type image_pos,
+                                       ifstream &label_ifs, ifstream::pos_type label_pos,
+                                       int number_of_data, ImageMatrixXf &images, LabelVectorXi &labels)
+    {
+        int pixels = _rows * _cols;
+        vector<unsigned char> buffer((size_t)number_of_data * pixels);
+
+        // 1サンプルずつシークせず、先頭から連続で読み出す
+        image_ifs.clear();
+        image_ifs.seekg(image_pos);
+        image_ifs.read((char *)buffer.data(), buffer.size());
+
+        images = Map<Matrix<unsigned char, Dynamic, Dynamic, RowMajor>>(buffer.data(), number_of_data, pixels).cast<float>() / 255.0f;
+
+        buffer.resize(number_of_data);
+        label_ifs.clear();
+        label_ifs.seekg(label_pos);
+        label_ifs.read((char *)buffer.data(), number_of_data);
+
+        labels = Map<Matrix<unsigned char, Dynamic, 1>>(buffer.data(), number_of_data).cast<int>();
+    }
+
     void MnistEigenDataset::_init_train_loader(void)
     {
         // 設定したファイルパスに基づいてファイルオープン
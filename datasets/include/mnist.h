@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <random>
 #include <Eigen/Dense>
 
 namespace MyDL
@@ -17,11 +18,101 @@ namespace MyDL
 
     int LittleEndian2BigEndian(int);
 
+    // 全データ一括ビュー用の型(float, 行優先, 正規化済み：1行 = 1画像)
+    typedef Matrix<float, Dynamic, Dynamic, RowMajor> ImageMatrixXf;
+    typedef Matrix<int, Dynamic, 1> LabelVectorXi;
+    // 生の画素値(0~255)のビュー用の型(行優先：1行 = 1画像)
+    typedef Matrix<unsigned char, Dynamic, Dynamic, RowMajor> ImageMatrixXu8;
+
+    // 画像バッチの CSR 形式(画素値が0でない要素のみ保持：1行 = 1画像)
+    // 行 i の要素は [row_ptr[i], row_ptr[i + 1]) にあり、col_idx はその行の非0画素のインデックス(昇順)。
+    // clear は確保済みの領域を残すので、同じ MnistEigenDataset から繰り返し読み出してもメモリ確保はほぼ発生しない。
+    template <typename Scalar>
+    struct SparseImageBatch
+    {
+        int rows = 0;
+        int cols = 0;
+        vector<int> row_ptr = vector<int>(1, 0);
+        vector<int> col_idx;
+        vector<Scalar> values;
+
+        int nnz(void) const { return (int)col_idx.size(); }
+        double density(void) const { return rows > 0 && cols > 0 ? (double)nnz() / ((double)rows * cols) : 0; }
+
+        void clear(int num_cols)
+        {
+            rows = 0;
+            cols = num_cols;
+            row_ptr.assign(1, 0);
+            col_idx.clear();
+            values.clear();
+        }
+
+        // 1行追加(0の要素は保持しない)
+        template <typename T>
+        void append_row(const T *row)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                if (row[j] != 0)
+                {
+                    col_idx.push_back(j);
+                    values.push_back((Scalar)row[j]);
+                }
+            }
+            row_ptr.push_back((int)col_idx.size());
+            rows++;
+        }
+
+        void from_dense(const Ref<const Matrix<Scalar, Dynamic, Dynamic, RowMajor>> &X)
+        {
+            clear((int)X.cols());
+            for (Index i = 0; i < X.rows(); i++)
+            {
+                append_row(X.row(i).data());
+            }
+        }
+
+        template <typename MatrixType>
+        void to_dense(MatrixType &X) const
+        {
+            X.setZero(rows, cols);
+            for (int i = 0; i < rows; i++)
+            {
+                for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++)
+                {
+                    X(i, col_idx[k]) = values[k];
+                }
+            }
+        }
+    };
+
+    typedef SparseImageBatch<double> SparseImageBatchXd;
+    typedef SparseImageBatch<float> SparseImageBatchXf;
+
+    // 画像データの読み出し方式
+    enum class LoaderBackend
+    {
+        InMemory,  // ファイル全体をメモリに読み込む
+        Mmap,      // ファイルをmmapして直接読み出す(常駐はOSのページキャッシュに任せる)
+        Streaming, // ファイルから逐次読み出し(シャッフルバッファ単位で連続読み出し)
+    };
+
+    // メモリ予算(byte)：コンストラクタで読み出し方式を自動選択するときに使う
+    struct LoaderMemoryBudget
+    {
+        size_t bytes;
+        explicit LoaderMemoryBudget(size_t b) : bytes(b) {}
+    };
+
+    class MnistSubsetView;
+
     // ---------------------------------------------
     //              Eigen用 MNISTローダ
     // ---------------------------------------------
     class MnistEigenDataset
     {
+        friend class MnistSubsetView;
 
     private:
         // ファイル入力用
@@ -50,26 +141,117 @@ namespace MyDL
         int _test_max_batch_num;
         int _train_load_count = 0;
         int _test_load_count = 0;
+        int _train_epoch = 0;
+        bool _random_load = true;
+        std::mt19937_64 _rng; // シャッフル用乱数生成器(エポックごとの再シャッフルにも使う)
 
         int _number_of_train_data = 0;
         int _number_of_test_data = 0;
         int _rows = 0;
         int _cols = 0;
 
+        // 読み出し方式ごとの読み出し元(訓練/テストそれぞれ)
+        struct SampleSource
+        {
+            const unsigned char *images = nullptr; // InMemory, Mmap：先頭画像へのポインタ
+            const unsigned char *labels = nullptr;
+            vector<unsigned char> image_bytes;     // InMemory：ファイル内容 / Streaming：シャッフルバッファ
+            vector<unsigned char> label_bytes;
+            void *map_addr[2] = {nullptr, nullptr}; // Mmap：munmap用
+            size_t map_len[2] = {0, 0};
+            int block_begin = -1;                  // Streaming：バッファに載っている先頭インデックス
+        };
+        LoaderBackend _backend = LoaderBackend::Streaming;
+        int _stream_block_size = 1; // Streaming時のシャッフルバッファのサンプル数(1なら1枚ずつシーク)
+        SampleSource _train_source;
+        SampleSource _test_source;
+        SampleSource _subset_source; // Streaming：部分集合ビュー用のシャッフルバッファ(訓練用のブロックを追い出さないよう別に持つ)
+
+        // 全データ一括ビュー用の保持領域(初回アクセス時に一度だけ構築)
+        ImageMatrixXf _train_images_full;
+        ImageMatrixXf _test_images_full;
+        LabelVectorXi _train_labels_full;
+        LabelVectorXi _test_labels_full;
+        vector<unsigned char> _train_images_raw; // Streaming時の生画素ビュー用の保持領域
+        vector<unsigned char> _test_images_raw;
+
     private:
         void _init_train_loader(void);
         void _init_test_loader(void);
+        void _select_backend(size_t);
+        bool _map_source(SampleSource &, const string &, ifstream::pos_type, const string &, ifstream::pos_type);
+        void _read_source(SampleSource &, ifstream &, ifstream::pos_type, ifstream &, ifstream::pos_type, int);
+        void _fill_stream_block(bool, SampleSource &, int);
+        void _shuffle_indices(vector<int> &);
+        template <typename ImageType, typename MatrixType>
+        void _load_batch(bool, SampleSource &, const vector<int> &, int, int, ImageType &, MatrixType &, bool, bool);
+        void _read_image(bool, SampleSource *, int, unsigned char *);
+        unsigned char _read_label(bool, SampleSource *, int);
+        MnistSubsetView _split_train(const vector<int> &);
+        void _load_full(ifstream &, ifstream::pos_type, ifstream &, ifstream::pos_type, int, ImageMatrixXf &, LabelVectorXi &);
+        Map<const ImageMatrixXu8> _raw_images(const SampleSource &, ifstream &, ifstream::pos_type, int, vector<unsigned char> &);
 
     public:
         MnistEigenDataset(){}; // デフォルトコンストラクタ
-        MnistEigenDataset(const int batch_size, bool random_load = true);
+        MnistEigenDataset(const int batch_size, bool random_load = true, unsigned long long seed = std::mt19937_64::default_seed);
+        MnistEigenDataset(const int batch_size, LoaderMemoryBudget budget, bool random_load = true, unsigned long long seed = std::mt19937_64::default_seed);
+        ~MnistEigenDataset();
         void set_train_image_filepath(string);
         void set_train_label_filepath(string);
         void set_test_image_filepath(string);
         void set_test_label_filepath(string);
         void initialize_loader(void);
-        void next_train(MatrixXd &, MatrixXd &, bool one_hot_label = false, bool normalize = true);
-        void next_test(MatrixXd &, MatrixXd &, bool one_hot_label = false, bool normalize = true);
+        // バッチ読み出し(MatrixType は MatrixXd / MatrixXf)
+        // 画像は MatrixType の代わりに SparseImageBatch(同じ Scalar)で受け取ることもできる(非0の画素のみ)
+        template <typename ImageType, typename MatrixType>
+        void next_train(ImageType &, MatrixType &, bool one_hot_label = false, bool normalize = true);
+        template <typename ImageType, typename MatrixType>
+        void next_test(ImageType &, MatrixType &, bool one_hot_label = false, bool normalize = true);
+        int epoch(void) const { return _train_epoch; }
+        int batch_size(void) const { return _batch_size; }
+        LoaderBackend backend(void) const { return _backend; }
+        string backend_name(void) const;
+
+        // 読み出し位置の保存・復元(シャッフル順・エポック・読み出しカウンタ・乱数状態)
+        vector<char> save_state(void) const;
+        void save_state(vector<char> &) const; // 既存の領域を再利用して書き込む版
+        bool load_state(const vector<char> &); // 形式やデータ数が合わない場合はfalse(状態は変更しない)
+
+        // 全データを1つの連続した行列として参照(コピーなし・ファイル順・0~1に正規化済み)
+        Map<const ImageMatrixXf> train_images(void);
+        Map<const LabelVectorXi> train_labels(void);
+        Map<const ImageMatrixXf> test_images(void);
+        Map<const LabelVectorXi> test_labels(void);
+        // 全画像の生の画素値(ファイル順・正規化なし)。InMemory / Mmap では読み出し元をそのまま参照する(コピーなし)
+        Map<const ImageMatrixXu8> train_images_raw(void);
+        Map<const ImageMatrixXu8> test_images_raw(void);
+
+        // 訓練データから検証用データを切り出す(切り出した分は next_train の対象から外れる)
+        // 引数が不正な場合や、検証用・訓練用のどちらかが空になる場合は空のビュー(size() == 0)を返し、訓練データは変更しない
+        MnistSubsetView split_validation_range(int begin, int end);                          // インデックス範囲指定
+        MnistSubsetView split_validation_stratified(double fraction, unsigned int seed = 0); // ラベルごとの層化抽出
+    };
+
+    // ---------------------------------------------
+    //     訓練データの部分集合ビュー(検証用など)
+    // ---------------------------------------------
+    // 画像・ラベルはコピーせず、元の MnistEigenDataset のファイルハンドル経由で読み出す。
+    // (元の MnistEigenDataset より長く使わないこと)
+    class MnistSubsetView
+    {
+    private:
+        MnistEigenDataset *_dataset;
+        vector<int> _indices;
+        int _batch_size;
+        int _max_batch_num;
+        int _load_count = 0;
+
+    public:
+        MnistSubsetView(MnistEigenDataset *, const vector<int> &, int);
+        template <typename MatrixType>
+        void next(MatrixType &, MatrixType &, bool one_hot_label = false, bool normalize = true);
+        int size(void) const { return (int)_indices.size(); }
+        const vector<int> &indices(void) const { return _indices; }
     };
 }
 
@@ -0,0 +1,267 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "model_file.h"
+
+namespace MyDL{
+
+    static const char CHECKPOINT_MAGIC[8] = {'M', 'Y', 'D', 'L', 'C', 'K', 'P', 'T'};
+
+    struct CheckpointHeader{
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        int64_t step;
+        uint64_t checksum;      // 3つの内容(長さ込み)の model_checksum を順に混ぜたもの
+        uint64_t sizes[3];      // パラメータ, 最適化手法, ローダ
+    };
+
+    static uint64_t checkpoint_checksum(const vector<char> *sections[3])
+    {
+        uint64_t hash = 0;
+        for (int i = 0; i < 3; i++){
+            hash = hash * 1099511628211ULL ^ model_checksum(sections[i]->data(), sections[i]->size());
+        }
+        return hash;
+    }
+
+    // path を含むディレクトリを fsync する(rename によるディレクトリエントリの置き換えを永続化する)
+    static bool fsync_parent_directory(const string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        string dir = slash == string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0){
+            return false;
+        }
+        bool ok = ::fsync(fd) == 0;
+        ok = (::close(fd) == 0) && ok;
+        return ok;
+    }
+
+    AsyncCheckpointer::AsyncCheckpointer(const string &path) : _path(path)
+    {
+        _writer = std::thread(&AsyncCheckpointer::_writer_loop, this);
+    }
+
+    AsyncCheckpointer::~AsyncCheckpointer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _writer.join();
+    }
+
+    // 書き込み先のバッファを決める：書き出し中でない方(書き出し待ちなら取り下げて上書きする)
+    int AsyncCheckpointer::_begin_snapshot(void)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        int slot = _writing == 0 ? 1 : 0;
+        if (_pending >= 0){
+            slot = _pending;
+            _pending = -1;
+            _skipped++;
+        }
+        return slot;
+    }
+
+    void AsyncCheckpointer::_commit_snapshot(int slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _pending = slot;
+        }
+        _cv.notify_all();
+    }
+
+    template <typename Scalar>
+    void AsyncCheckpointer::save(long step, const BasicParameterBuffer<Scalar> &params, const BasicOptimizer<Scalar> *optimizer, const MnistEigenDataset *loader)
+    {
+        int slot = _begin_snapshot();
+        Snapshot &snapshot = _slots[slot];
+
+        // 各バッファの領域は使い回す(2回目以降はメモリ確保・ページフォルトなしのコピーのみ)
+        const char *p = reinterpret_cast<const char *>(params.data());
+        snapshot.step = step;
+        snapshot.params.assign(p, p + params.size() * sizeof(Scalar));
+        if (optimizer){
+            optimizer->save_state(snapshot.optimizer);
+        }
+        else{
+            snapshot.optimizer.clear();
+        }
+        if (loader){
+            loader->save_state(snapshot.loader);
+        }
+        else{
+            snapshot.loader.clear();
+        }
+
+        _commit_snapshot(slot);
+    }
+
+    void AsyncCheckpointer::_writer_loop(void)
+    {
+        while (true){
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this]{ return _stop || _pending >= 0; });
+                if (_pending < 0){
+                    return; // 終了(書き出し待ちなし)
+                }
+                slot = _writing = _pending;
+                _pending = -1;
+            }
+
+            bool ok = _write(_slots[slot]);
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _writing = -1;
+                _failed = _failed || !ok;
+                if (ok){
+                    _written_step = _slots[slot].step;
+                }
+            }
+            _cv.notify_all();
+        }
+    }
+
+    // 一時ファイルに書いて fsync → rename(同じディレクトリ内なので置き換えはアトミック) → ディレクトリを fsync
+    bool AsyncCheckpointer::_write(const Snapshot &snapshot)
+    {
+        const vector<char> *sections[3] = {&snapshot.params, &snapshot.optimizer, &snapshot.loader};
+        CheckpointHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        header.version = VERSION;
+        header.step = snapshot.step;
+        header.checksum = checkpoint_checksum(sections);
+        for (int i = 0; i < 3; i++){
+            header.sizes[i] = sections[i]->size();
+        }
+
+        string tmp_path = _path + ".tmp";
+        int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0){
+            return false;
+        }
+        auto write_all = [fd](const char *data, size_t size){
+            while (size > 0){
+                ssize_t n = ::write(fd, data, size);
+                if (n < 0){
+                    if (errno == EINTR){
+                        continue; // シグナルで中断されただけなので書き直す
+                    }
+                    return false;
+                }
+                data += n;
+                size -= n;
+            }
+            return true;
+        };
+
+        bool ok = write_all(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (int i = 0; i < 3 && ok; i++){
+            ok = write_all(sections[i]->data(), sections[i]->size());
+        }
+        ok = ok && ::fsync(fd) == 0;
+        ok = (::close(fd) == 0) && ok;
+        ok = ok && std::rename(tmp_path.c_str(), _path.c_str()) == 0;
+        if (!ok){
+            std::remove(tmp_path.c_str());
+            return false;
+        }
+        return fsync_parent_directory(_path);
+    }
+
+    bool AsyncCheckpointer::wait(void)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]{ return _pending < 0 && _writing < 0; });
+        return !_failed;
+    }
+
+    long AsyncCheckpointer::written_step(void)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _written_step;
+    }
+
+    long AsyncCheckpointer::skipped(void)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _skipped;
+    }
+
+    template <typename Scalar>
+    bool AsyncCheckpointer::load(const string &path, long &step, BasicParameterBuffer<Scalar> &params, BasicOptimizer<Scalar> *optimizer, MnistEigenDataset *loader)
+    {
+        FILE *fp = std::fopen(path.c_str(), "rb");
+        if (!fp){
+            return false;
+        }
+        struct stat st;
+        if (::fstat(::fileno(fp), &st) != 0){
+            std::fclose(fp);
+            return false;
+        }
+        const uint64_t file_size = (uint64_t)st.st_size;
+
+        CheckpointHeader header;
+        vector<char> sections[3];
+        bool ok = std::fread(&header, sizeof(header), 1, fp) == 1 &&
+                  std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) == 0 &&
+                  header.version == VERSION &&
+                  header.sizes[0] == params.size() * sizeof(Scalar);
+        // 各セクションの長さはファイルの残りに収まり、合計がファイルサイズと一致すること(壊れたヘッダで巨大な確保をしない)
+        uint64_t remaining = ok ? file_size - sizeof(header) : 0;
+        for (int i = 0; i < 3 && ok; i++){
+            ok = header.sizes[i] <= remaining;
+            remaining -= ok ? header.sizes[i] : 0;
+        }
+        ok = ok && remaining == 0;
+        for (int i = 0; i < 3 && ok; i++){
+            sections[i].resize(header.sizes[i]);
+            ok = std::fread(sections[i].data(), 1, sections[i].size(), fp) == sections[i].size();
+        }
+        std::fclose(fp);
+
+        const vector<char> *section_ptrs[3] = {&sections[0], &sections[1], &sections[2]};
+        if (!ok || checkpoint_checksum(section_ptrs) != header.checksum){
+            return false;
+        }
+
+        // 最適化手法・ローダの状態が読めることを確認してからパラメータを反映(失敗したら何も変更しない)
+        if (optimizer && !sections[1].empty()){
+            BasicOptimizer<Scalar> restored(optimizer->config());
+            if (!restored.load_state(sections[1], params.size())){
+                return false;
+            }
+        }
+        if (loader && !sections[2].empty() && !loader->load_state(sections[2])){
+            return false;
+        }
+        if (optimizer && !sections[1].empty()){
+            optimizer->load_state(sections[1], params.size());
+        }
+        std::memcpy(params.data(), sections[0].data(), sections[0].size());
+        step = header.step;
+        return true;
+    }
+
+    template void AsyncCheckpointer::save<double>(long, const BasicParameterBuffer<double> &, const BasicOptimizer<double> *, const MnistEigenDataset *);
+    template void AsyncCheckpointer::save<float>(long, const BasicParameterBuffer<float> &, const BasicOptimizer<float> *, const MnistEigenDataset *);
+    template void AsyncCheckpointer::save<bfloat16>(long, const BasicParameterBuffer<bfloat16> &, const BasicOptimizer<bfloat16> *, const MnistEigenDataset *);
+    template bool AsyncCheckpointer::load<double>(const string &, long &, BasicParameterBuffer<double> &, BasicOptimizer<double> *, MnistEigenDataset *);
+    template bool AsyncCheckpointer::load<float>(const string &, long &, BasicParameterBuffer<float> &, BasicOptimizer<float> *, MnistEigenDataset *);
+    template bool AsyncCheckpointer::load<bfloat16>(const string &, long &, BasicParameterBuffer<bfloat16> &, BasicOptimizer<bfloat16> *, MnistEigenDataset *);
+
+}
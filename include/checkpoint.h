@@ -0,0 +1,87 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include "parameter_buffer.h"
+#include "optimizer.h"
+#include "mnist.h"
+
+namespace MyDL{
+
+    using std::string;
+    using std::vector;
+
+    // ---------------------------------------------
+    //     非同期チェックポイント
+    // ---------------------------------------------
+    // save はパラメータ・最適化手法の状態・データローダの読み出し位置を2つあるバッファの片方にコピーして
+    // すぐに戻る(学習ループが止まるのはコピーの間だけ)。ファイルへの書き出しは専用スレッドが行い、
+    // 一時ファイル(path + ".tmp")に書いて fsync してから rename で置き換えるので、
+    // 書き出し中に落ちても path には常に完全なチェックポイントが残る。
+    // 書き出しが次の save に間に合わない場合は、まだ書き出していないバッファを新しい内容で上書きする
+    // (学習ループは待たない。書き出されるのは常に最新のスナップショット)。
+    // ファイル形式：[magic "MYDLCKPT"][バージョン][ステップ][チェックサム] + (長さ, 内容) × 3(パラメータ, 最適化手法, ローダ)
+    class AsyncCheckpointer{
+        public:
+            static const uint32_t VERSION = 1;
+
+        private:
+            struct Snapshot{
+                long step = 0;
+                vector<char> params;
+                vector<char> optimizer;
+                vector<char> loader;
+            };
+
+            string _path;
+            Snapshot _slots[2];
+            int _pending = -1;          // 書き出し待ちのバッファ
+            int _writing = -1;          // 書き出し中のバッファ
+            long _written_step = -1;    // 最後に書き出しが完了したステップ
+            long _skipped = 0;          // 書き出す前に上書きされたスナップショットの数
+            bool _failed = false;
+            bool _stop = false;
+
+            std::mutex _mutex;
+            std::condition_variable _cv;
+            std::thread _writer;
+
+        private:
+            void _writer_loop(void);
+            bool _write(const Snapshot &);
+            int _begin_snapshot(void);
+            void _commit_snapshot(int);
+
+        public:
+            explicit AsyncCheckpointer(const string &path);
+            ~AsyncCheckpointer(); // 書き出し待ちの分を書き終えてから終了する
+            AsyncCheckpointer(const AsyncCheckpointer &) = delete;
+            AsyncCheckpointer &operator=(const AsyncCheckpointer &) = delete;
+
+            // スナップショットを取って書き出しを依頼する(optimizer, loader は nullptr なら保存しない)
+            template <typename Scalar>
+            void save(long step, const BasicParameterBuffer<Scalar> &params, const BasicOptimizer<Scalar> *optimizer, const MnistEigenDataset *loader);
+
+            bool wait(void);                // 書き出し待ちの分が終わるまで待つ(書き出しに失敗したことがあればfalse)
+            long written_step(void);        // 最後に書き出しが完了したステップ(まだなければ-1)
+            long skipped(void);
+            const string &path(void) const { return _path; }
+
+            // チェックポイントを読み込んで復元する(ファイルがない・形式やサイズが合わない場合はfalse。その場合は何も変更しない)
+            template <typename Scalar>
+            static bool load(const string &path, long &step, BasicParameterBuffer<Scalar> &params, BasicOptimizer<Scalar> *optimizer, MnistEigenDataset *loader);
+    };
+
+    extern template void AsyncCheckpointer::save<double>(long, const BasicParameterBuffer<double> &, const BasicOptimizer<double> *, const MnistEigenDataset *);
+    extern template void AsyncCheckpointer::save<float>(long, const BasicParameterBuffer<float> &, const BasicOptimizer<float> *, const MnistEigenDataset *);
+    extern template void AsyncCheckpointer::save<bfloat16>(long, const BasicParameterBuffer<bfloat16> &, const BasicOptimizer<bfloat16> *, const MnistEigenDataset *);
+    extern template bool AsyncCheckpointer::load<double>(const string &, long &, BasicParameterBuffer<double> &, BasicOptimizer<double> *, MnistEigenDataset *);
+    extern template bool AsyncCheckpointer::load<float>(const string &, long &, BasicParameterBuffer<float> &, BasicOptimizer<float> *, MnistEigenDataset *);
+    extern template bool AsyncCheckpointer::load<bfloat16>(const string &, long &, BasicParameterBuffer<bfloat16> &, BasicOptimizer<bfloat16> *, MnistEigenDataset *);
+}
+
+#endif // _CHECKPOINT_H_
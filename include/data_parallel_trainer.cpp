@@ -0,0 +1,102 @@
+#include <algorithm>
+#include <Eigen/Dense>
+#include "data_parallel_trainer.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    template <typename Scalar>
+    BasicDataParallelTrainer<Scalar>::BasicDataParallelTrainer(Net &net, int num_slices, int num_threads)
+        : _net(&net), _pool(num_threads)
+    {
+        _num_slices = num_slices > 0 ? num_slices : _pool.size();
+        _ws.resize(_num_slices);
+        _grads.assign(_num_slices, net.grads); // net.grads と同じ配置
+        _results.resize(_num_slices);
+    }
+
+    // スライスごとの順伝播・逆伝播 → 固定順の木で足し合わせて net.grads に書き込む
+    template <typename Scalar>
+    TrainStepResult BasicDataParallelTrainer<Scalar>::_compute_gradient(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t)
+    {
+        const Index batch_size = X.rows();
+        const Index base_rows = batch_size / _num_slices;
+        const Index extra_rows = batch_size % _num_slices; // 先頭の extra_rows 個のスライスは1行多い
+
+        _pool.parallel_for(_num_slices, [&](int slice, int){
+            Index rows = base_rows + (slice < extra_rows ? 1 : 0);
+            Index start = slice * base_rows + std::min<Index>(slice, extra_rows);
+
+            if (rows == 0){
+                // バッチサイズがスライス数より小さい場合：空のスライスは勾配0
+                _grads[slice].setZero();
+                _results[slice] = TrainStepResult();
+                return;
+            }
+
+            _results[slice] = _net->forward_backward(X.middleRows(start, rows), t.middleRows(start, rows), _ws[slice], _grads[slice]);
+            // スライス内の平均 → バッチ全体の平均への重み
+            _grads[slice].flat() *= (ComputeScalar)((double)rows / batch_size);
+        });
+
+        _tree_reduce();
+        _net->grads.flat() = _grads[0].flat();
+
+        // 損失・精度もスライス順に重み付きで足す
+        TrainStepResult result;
+        for (int slice = 0; slice < _num_slices; slice++){
+            double weight = (double)(base_rows + (slice < extra_rows ? 1 : 0)) / batch_size;
+            result.loss += weight * _results[slice].loss;
+            result.accuracy += weight * _results[slice].accuracy;
+        }
+        return result;
+    }
+
+    // 2分木の足し合わせ：各段で (i, i + stride) の組を足す。組どうし・チャンクどうしは独立なので並列に実行する
+    template <typename Scalar>
+    void BasicDataParallelTrainer<Scalar>::_tree_reduce(void)
+    {
+        const Index size = _grads[0].size();
+        const int num_chunks = (int)((size + REDUCE_CHUNK - 1) / REDUCE_CHUNK);
+
+        for (int stride = 1; stride < _num_slices; stride *= 2){
+            int num_pairs = (_num_slices - stride + 2 * stride - 1) / (2 * stride);
+            _pool.parallel_for(num_pairs * num_chunks, [&](int task, int){
+                int dst = (task / num_chunks) * 2 * stride;
+                Index begin = (Index)(task % num_chunks) * REDUCE_CHUNK;
+                Index n = std::min(REDUCE_CHUNK, size - begin);
+                _grads[dst].flat().segment(begin, n) += _grads[dst + stride].flat().segment(begin, n);
+            });
+        }
+    }
+
+    template <typename Scalar>
+    const BasicParameterBuffer<typename BasicDataParallelTrainer<Scalar>::ComputeScalar> &
+    BasicDataParallelTrainer<Scalar>::gradient(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t)
+    {
+        _compute_gradient(X, t);
+        return _net->grads;
+    }
+
+    template <typename Scalar>
+    TrainStepResult BasicDataParallelTrainer<Scalar>::train_step(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t, double learning_rate)
+    {
+        TrainStepResult result = _compute_gradient(X, t);
+        _net->params.flat() = (_net->params.flat().template cast<ComputeScalar>() - (ComputeScalar)learning_rate * _net->grads.flat()).template cast<Scalar>();
+        return result;
+    }
+
+    template <typename Scalar>
+    TrainStepResult BasicDataParallelTrainer<Scalar>::train_step(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t, BasicOptimizer<Scalar> &optimizer)
+    {
+        TrainStepResult result = _compute_gradient(X, t);
+        optimizer.update(_net->params, _net->grads);
+        return result;
+    }
+
+    template class BasicDataParallelTrainer<double>;
+    template class BasicDataParallelTrainer<float>;
+    template class BasicDataParallelTrainer<bfloat16>;
+
+}
@@ -0,0 +1,62 @@
+#ifndef _DATA_PARALLEL_TRAINER_H_
+#define _DATA_PARALLEL_TRAINER_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+#include "optimizer.h"
+#include "thread_pool.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // ---------------------------------------------
+    //     データ並列学習(スレッド並列)
+    // ---------------------------------------------
+    // バッチを num_slices 個のスライス(行方向)に分け、各スライスの順伝播・逆伝播をスレッドプールで並列に行う。
+    // スライスごとの勾配は専用のバッファに書き込み、(スライスの行数 / バッチサイズ) を掛けてから
+    // 固定順の2分木で足し合わせる(0 += 1, 2 += 3, ... → 0 += 2, ... → 0 += 4, ...)。
+    // 足し合わせの順序はスライス数だけで決まるので、スレッド数や実行タイミングによらず結果はビット単位で一致する。
+    template <typename Scalar>
+    class BasicDataParallelTrainer{
+        public:
+            typedef BasicTwoLayerNet<Scalar> Net;
+            typedef typename Net::ComputeScalar ComputeScalar;
+            typedef typename Net::ComputeMatrix ComputeMatrix;
+            static const Index REDUCE_CHUNK = 16384; // 足し合わせ1タスクあたりの要素数
+
+        private:
+            Net *_net;
+            ThreadPool _pool;
+            int _num_slices;
+            vector<typename Net::Workspace> _ws;                  // スライスごとの作業領域
+            vector<BasicParameterBuffer<ComputeScalar>> _grads;   // スライスごとの勾配
+            vector<TrainStepResult> _results;                     // スライスごとの損失・精度
+
+        private:
+            TrainStepResult _compute_gradient(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &);
+            void _tree_reduce(void);
+
+        public:
+            // num_slices = 0 のときはスレッド数と同じ(スレッド数を変えても結果を一致させたいときは明示する)
+            BasicDataParallelTrainer(Net &net, int num_slices = 0, int num_threads = 0);
+
+            const BasicParameterBuffer<ComputeScalar> &gradient(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &); // 結果は net.grads
+            TrainStepResult train_step(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, double);
+            TrainStepResult train_step(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, BasicOptimizer<Scalar> &);
+
+            int num_slices(void) const { return _num_slices; }
+            int num_threads(void) const { return _pool.size(); }
+    };
+
+    typedef BasicDataParallelTrainer<double> DataParallelTrainer;
+    typedef BasicDataParallelTrainer<float> DataParallelTrainerF;
+
+    extern template class BasicDataParallelTrainer<double>;
+    extern template class BasicDataParallelTrainer<float>;
+    extern template class BasicDataParallelTrainer<bfloat16>;
+}
+
+#endif // _DATA_PARALLEL_TRAINER_H_
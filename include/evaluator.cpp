@@ -0,0 +1,58 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <Eigen/Dense>
+#include "evaluator.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    Evaluator::Evaluator(int chunk_size, int num_threads) : _pool(num_threads), _chunk_size(chunk_size)
+    {
+    }
+
+    template <typename Scalar>
+    static void score_impl(const Ref<const Matrix<Scalar, Dynamic, Dynamic>> &y, const Ref<const LabelVectorXi> &labels, EvaluationResult &result)
+    {
+        const Scalar tiny = std::numeric_limits<Scalar>::min();
+        result.confusion = MatrixXi::Zero(y.cols(), y.cols());
+        for (Index i = 0; i < y.rows(); i++){
+            Index pred;
+            y.row(i).maxCoeff(&pred);
+            int label = labels(i);
+
+            result.loss_sum -= std::log(std::max(y(i, label), tiny));
+            result.correct += (pred == label);
+            result.confusion(label, pred)++;
+        }
+        result.total += y.rows();
+    }
+
+    void Evaluator::_score(const Ref<const MatrixXd> &y, const Ref<const LabelVectorXi> &labels, EvaluationResult &result)
+    {
+        score_impl<double>(y, labels, result);
+    }
+
+    void Evaluator::_score(const Ref<const MatrixXf> &y, const Ref<const LabelVectorXi> &labels, EvaluationResult &result)
+    {
+        score_impl<float>(y, labels, result);
+    }
+
+    // 最終集計：チャンク番号順に足し合わせる
+    EvaluationResult Evaluator::_reduce(const vector<EvaluationResult> &per_chunk, int output_size)
+    {
+        EvaluationResult result;
+        result.confusion = MatrixXi::Zero(output_size, output_size);
+        for (const auto &p : per_chunk){
+            result.correct += p.correct;
+            result.total += p.total;
+            result.loss_sum += p.loss_sum;
+            result.confusion += p.confusion;
+        }
+
+        return result;
+    }
+
+}
@@ -0,0 +1,87 @@
+#ifndef _EVALUATOR_H_
+#define _EVALUATOR_H_
+
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+#include "thread_pool.h"
+#include "mnist.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // 評価結果(全件分を集計したもの)
+    struct EvaluationResult{
+        int correct = 0;        // 正解数
+        int total = 0;          // 評価したサンプル数
+        double loss_sum = 0;    // 交差エントロピー誤差の総和
+        MatrixXi confusion;     // 混同行列(行：正解ラベル, 列：予測ラベル)
+
+        double accuracy(void) const { return total > 0 ? (double)correct / total : 0; }
+        double loss(void) const { return total > 0 ? loss_sum / total : 0; }
+    };
+
+    // ---------------------------------------------
+    //     テストデータ全件評価(スレッド並列)
+    // ---------------------------------------------
+    // 全データビューを固定サイズのチャンクに分け、各チャンクを net.infer(スレッドごとの作業領域)で推論する。
+    // 正解数・損失・混同行列はチャンクごとに集計し、最後にチャンク番号順でまとめる
+    // (チャンクをどのスレッドが処理しても、損失の足し合わせる順序は同じ → 結果はスレッド数によらず一致する)。
+    class Evaluator{
+        private:
+            ThreadPool _pool;
+            int _chunk_size;
+
+        private:
+            // 1チャンク分の softmax の出力を集計する(損失は -log(max(y, 最小の正規化数)))
+            static void _score(const Ref<const MatrixXd> &, const Ref<const LabelVectorXi> &, EvaluationResult &);
+            static void _score(const Ref<const MatrixXf> &, const Ref<const LabelVectorXi> &, EvaluationResult &);
+            static EvaluationResult _reduce(const vector<EvaluationResult> &, int);
+
+            template <typename Net>
+            EvaluationResult _evaluate(const Net &net, const Ref<const ImageMatrixXf> &images, const Ref<const LabelVectorXi> &labels)
+            {
+                typedef typename Net::ComputeMatrix ComputeMatrix;
+
+                int num_data = images.rows();
+                int num_chunks = (num_data + _chunk_size - 1) / _chunk_size;
+                int num_threads = _pool.size();
+
+                // チャンクごとの部分集計と、スレッドごとの作業領域(チャンク間で使い回す)
+                vector<EvaluationResult> per_chunk(num_chunks);
+                vector<ComputeMatrix> X_buf(num_threads);
+                vector<typename Net::InferenceWorkspace> ws(num_threads);
+
+                _pool.parallel_for(num_chunks, [&](int chunk, int thread_id){
+                    int start = chunk * _chunk_size;
+                    int rows = std::min(_chunk_size, num_data - start);
+                    ComputeMatrix &X = X_buf[thread_id];
+                    X = images.middleRows(start, rows).template cast<typename Net::ComputeScalar>();
+                    _score(net.infer(X, ws[thread_id]), labels.segment(start, rows), per_chunk[chunk]);
+                });
+
+                return _reduce(per_chunk, net.params.matrix(Net::W2).cols());
+            }
+
+        public:
+            Evaluator(int chunk_size = 500, int num_threads = 0);
+
+            template <typename Scalar, int In, int Hidden, int Out, int Batch>
+            EvaluationResult evaluate(const BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> &net, const Ref<const ImageMatrixXf> &images, const Ref<const LabelVectorXi> &labels)
+            {
+                return _evaluate(net, images, labels);
+            }
+
+            // テストデータ全件
+            template <typename Scalar, int In, int Hidden, int Out, int Batch>
+            EvaluationResult evaluate_test(const BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> &net, MnistEigenDataset &dataset)
+            {
+                return _evaluate(net, dataset.test_images(), dataset.test_labels());
+            }
+    };
+}
+
+#endif // _EVALUATOR_H_
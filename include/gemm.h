@@ -0,0 +1,76 @@
+#ifndef _GEMM_H_
+#define _GEMM_H_
+
+#include <algorithm>
+#include <type_traits>
+#include <Eigen/Dense>
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    // Eigenの行列積(GEMM)は、内部のパッキング用一時領域が EIGEN_STACK_ALLOCATION_LIMIT(既定128KB)
+    // を超えるとヒープに確保する。出力と内積方向を GEMM_TILE 単位に分けて積を取ることで、
+    // 一時領域を常にスタックに収め、学習ループ中のメモリ確保をなくす。
+    const Index GEMM_TILE = 128;
+
+    // C = A * B (accumulate = true のときは C += A * B)
+    // A, B の要素型が C と異なる場合(bfloat16で保持した重みなど)は、タイルごとにCの型へ変換してから積を取る。
+    // 変換先はスタック上のタイルなので、行列全体の変換コピーは作らない。
+    template <typename Lhs, typename Rhs, typename Dst>
+    void gemm_noalloc(const Lhs &A, const Rhs &B, Dst &&C, bool accumulate = false)
+    {
+        typedef typename std::decay<Dst>::type::Scalar Scalar;
+        typedef Matrix<Scalar, Dynamic, Dynamic, 0, GEMM_TILE, GEMM_TILE> Tile;
+        const bool convert_A = !std::is_same<typename Lhs::Scalar, Scalar>::value;
+        const bool convert_B = !std::is_same<typename Rhs::Scalar, Scalar>::value;
+        // 全次元がコンパイル時に決まっていて1タイルに収まる場合(固定サイズのネットワーク)は、
+        // Eigenの固定サイズ積(作業領域もスタック上)をそのまま使う
+        const bool single_fixed_tile = Lhs::RowsAtCompileTime != Dynamic && Lhs::RowsAtCompileTime <= GEMM_TILE &&
+                                       Lhs::ColsAtCompileTime != Dynamic && Lhs::ColsAtCompileTime <= GEMM_TILE &&
+                                       Rhs::ColsAtCompileTime != Dynamic && Rhs::ColsAtCompileTime <= GEMM_TILE;
+
+        if constexpr (single_fixed_tile && !convert_A && !convert_B){
+            if (accumulate){
+                C.noalias() += A * B;
+            }
+            else{
+                C.noalias() = A * B;
+            }
+            return;
+        }
+
+        if (!accumulate){
+            C.setZero();
+        }
+
+        for (Index j = 0; j < C.cols(); j += GEMM_TILE){
+            Index cols = std::min(GEMM_TILE, C.cols() - j);
+            for (Index i = 0; i < C.rows(); i += GEMM_TILE){
+                Index rows = std::min(GEMM_TILE, C.rows() - i);
+                for (Index k = 0; k < A.cols(); k += GEMM_TILE){
+                    Index depth = std::min(GEMM_TILE, A.cols() - k);
+
+                    if constexpr (!convert_A && !convert_B){
+                        C.block(i, j, rows, cols).noalias() += A.block(i, k, rows, depth) * B.block(k, j, depth, cols);
+                    }
+                    else if constexpr (!convert_A){
+                        Tile B_tile = B.block(k, j, depth, cols).template cast<Scalar>();
+                        C.block(i, j, rows, cols).noalias() += A.block(i, k, rows, depth) * B_tile;
+                    }
+                    else if constexpr (!convert_B){
+                        Tile A_tile = A.block(i, k, rows, depth).template cast<Scalar>();
+                        C.block(i, j, rows, cols).noalias() += A_tile * B.block(k, j, depth, cols);
+                    }
+                    else{
+                        Tile A_tile = A.block(i, k, rows, depth).template cast<Scalar>();
+                        Tile B_tile = B.block(k, j, depth, cols).template cast<Scalar>();
+                        C.block(i, j, rows, cols).noalias() += A_tile * B_tile;
+                    }
+                }
+            }
+        }
+    }
+}
+
+#endif // _GEMM_H_
@@ -0,0 +1,169 @@
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "gradient_compression.h"
+
+namespace MyDL{
+
+    // メッセージの先頭：種類と要素数(TopK は送る要素数)
+    struct CompressionHeader{
+        int32_t type;
+        int32_t count;
+    };
+
+    template <typename T>
+    BasicGradientCompressor<T>::BasicGradientCompressor(const CompressionConfig &config) : _config(config), _engine(config.seed)
+    {
+    }
+
+    template <typename T>
+    void BasicGradientCompressor<T>::compress(const T *grad, Index n, vector<char> &message)
+    {
+        switch (_config.type){
+        case CompressionType::None:{
+            CompressionHeader header = {(int32_t)CompressionType::None, (int32_t)n};
+            message.resize(sizeof(header) + n * sizeof(T));
+            std::memcpy(message.data(), &header, sizeof(header));
+            std::memcpy(message.data() + sizeof(header), grad, n * sizeof(T));
+            break;
+        }
+        case CompressionType::TopK:
+            _compress_topk(grad, n, message);
+            break;
+        case CompressionType::Int8:
+            _compress_int8(grad, n, message);
+            break;
+        }
+    }
+
+    template <typename T>
+    void BasicGradientCompressor<T>::_compress_topk(const T *grad, Index n, vector<char> &message)
+    {
+        if (_residual.size() != n){
+            _residual = Matrix<T, Dynamic, 1>::Zero(n);
+        }
+        // 残差に今回の勾配を足したものが送る候補
+        _residual += Map<const Matrix<T, Dynamic, 1>>(grad, n);
+
+        Index k = std::max<Index>(1, std::min<Index>(n, (Index)std::ceil(_config.topk_ratio * n)));
+        _indices.resize(n);
+        for (Index i = 0; i < n; i++){
+            _indices[i] = (uint32_t)i;
+        }
+        const T *r = _residual.data();
+        std::nth_element(_indices.begin(), _indices.begin() + (k - 1), _indices.end(),
+                         [r](uint32_t a, uint32_t b){ return std::abs(r[a]) > std::abs(r[b]); });
+        std::sort(_indices.begin(), _indices.begin() + k); // 受信側のアクセスを連続に近づける
+
+        CompressionHeader header = {(int32_t)CompressionType::TopK, (int32_t)k};
+        message.resize(sizeof(header) + k * (sizeof(uint32_t) + sizeof(float)));
+        std::memcpy(message.data(), &header, sizeof(header));
+        char *index_ptr = message.data() + sizeof(header);
+        char *value_ptr = index_ptr + k * sizeof(uint32_t);
+        for (Index i = 0; i < k; i++){
+            uint32_t index = _indices[i];
+            float value = (float)_residual[index];
+            std::memcpy(index_ptr + i * sizeof(uint32_t), &index, sizeof(uint32_t));
+            std::memcpy(value_ptr + i * sizeof(float), &value, sizeof(float));
+            _residual[index] -= (T)value; // 送った分を残差から引く(floatへの丸め誤差は残る)
+        }
+    }
+
+    template <typename T>
+    void BasicGradientCompressor<T>::_compress_int8(const T *grad, Index n, vector<char> &message)
+    {
+        const Index num_blocks = (n + BLOCK - 1) / BLOCK;
+        CompressionHeader header = {(int32_t)CompressionType::Int8, (int32_t)n};
+        message.resize(sizeof(header) + num_blocks * sizeof(float) + n);
+        std::memcpy(message.data(), &header, sizeof(header));
+        char *scale_ptr = message.data() + sizeof(header);
+        int8_t *q = reinterpret_cast<int8_t *>(scale_ptr + num_blocks * sizeof(float));
+
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        for (Index block = 0; block < num_blocks; block++){
+            Index begin = block * BLOCK;
+            Index size = std::min(BLOCK, n - begin);
+            Map<const Matrix<T, Dynamic, 1>> g(grad + begin, size);
+
+            float max_abs = (float)g.cwiseAbs().maxCoeff();
+            float scale = max_abs > 0 ? max_abs / 127 : 0;
+            std::memcpy(scale_ptr + block * sizeof(float), &scale, sizeof(float));
+
+            float inv_scale = max_abs > 0 ? 127 / max_abs : 0;
+            for (Index i = 0; i < size; i++){
+                // floor(x + u)：x の小数部分の確率で切り上げ(期待値 = x)
+                float x = (float)g[i] * inv_scale;
+                float rounded = std::floor(x + uniform(_engine));
+                q[begin + i] = (int8_t)std::max(-127.0f, std::min(127.0f, rounded));
+            }
+        }
+    }
+
+    // 受け取ったバイト列を検証してから足し込む(種類・要素数・バイト長が合わない、TopK のインデックスが範囲外なら false で out は変更しない)
+    template <typename T>
+    bool BasicGradientCompressor<T>::decompress_add(const vector<char> &message, T *out, Index n)
+    {
+        CompressionHeader header;
+        if (message.size() < sizeof(header)){
+            return false;
+        }
+        std::memcpy(&header, message.data(), sizeof(header));
+        const char *body = message.data() + sizeof(header);
+        const size_t body_bytes = message.size() - sizeof(header);
+
+        switch ((CompressionType)header.type){
+        case CompressionType::None:{
+            if (header.count != n || body_bytes != (size_t)n * sizeof(T)){
+                return false;
+            }
+            Map<Matrix<T, Dynamic, 1>>(out, n) += Map<const Matrix<T, Dynamic, 1>>(reinterpret_cast<const T *>(body), n);
+            return true;
+        }
+        case CompressionType::TopK:{
+            if (header.count < 0 || header.count > n || body_bytes != (size_t)header.count * (sizeof(uint32_t) + sizeof(float))){
+                return false;
+            }
+            // 先に全インデックスを確認してから足す(途中で失敗して一部だけ足された状態を残さない)
+            for (int32_t i = 0; i < header.count; i++){
+                uint32_t index;
+                std::memcpy(&index, body + i * sizeof(uint32_t), sizeof(uint32_t));
+                if ((Index)index >= n){
+                    return false;
+                }
+            }
+            const char *value_ptr = body + header.count * sizeof(uint32_t);
+            for (int32_t i = 0; i < header.count; i++){
+                uint32_t index;
+                float value;
+                std::memcpy(&index, body + i * sizeof(uint32_t), sizeof(uint32_t));
+                std::memcpy(&value, value_ptr + i * sizeof(float), sizeof(float));
+                out[index] += (T)value;
+            }
+            return true;
+        }
+        case CompressionType::Int8:{
+            const Index num_blocks = (n + BLOCK - 1) / BLOCK;
+            if (header.count != n || body_bytes != (size_t)num_blocks * sizeof(float) + n){
+                return false;
+            }
+            const int8_t *q = reinterpret_cast<const int8_t *>(body + num_blocks * sizeof(float));
+            for (Index block = 0; block < num_blocks; block++){
+                float scale;
+                std::memcpy(&scale, body + block * sizeof(float), sizeof(float));
+                Index begin = block * BLOCK;
+                Index size = std::min(BLOCK, n - begin);
+                for (Index i = 0; i < size; i++){
+                    out[begin + i] += (T)(scale * q[begin + i]);
+                }
+            }
+            return true;
+        }
+        }
+        return false; // 未知の種類
+    }
+
+    template class BasicGradientCompressor<double>;
+    template class BasicGradientCompressor<float>;
+
+}
@@ -0,0 +1,61 @@
+#ifndef _GRADIENT_COMPRESSION_H_
+#define _GRADIENT_COMPRESSION_H_
+
+#include <random>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <Eigen/Dense>
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    enum class CompressionType { None, TopK, Int8 };
+
+    struct CompressionConfig{
+        CompressionType type = CompressionType::None;
+        double topk_ratio = 0.01;   // TopK：送る要素の割合
+        unsigned seed = 0;          // Int8：確率的丸めの乱数シード(プロセスごとに rank を足して使う)
+    };
+
+    // ---------------------------------------------
+    //     勾配の圧縮(プロセス間の勾配交換用)
+    // ---------------------------------------------
+    // compress で勾配を1つのバイト列に変換し、decompress_add で受け取ったバイト列を足し込む。
+    //   TopK：誤差フィードバック付きの top-k 疎化。前回までに送れなかった分(残差)を足した勾配から
+    //         絶対値の大きい k 要素を (インデックス(uint32), 値(float)) の組で送り、残りは残差として次回に持ち越す。
+    //   Int8：BLOCK 要素ごとに scale = max|g| / 127 を求め、g / scale を確率的に丸めた int8 で送る
+    //         (期待値が元の値と一致するので残差は持たない)。
+    // 圧縮した結果は送信側・受信側で同じように復元されるので、全プロセスで同じ順に decompress_add すれば結果は一致する。
+    template <typename T>
+    class BasicGradientCompressor{
+        public:
+            static const Index BLOCK = 256; // Int8 のスケールを共有する要素数
+
+        private:
+            CompressionConfig _config;
+            Matrix<T, Dynamic, 1> _residual;    // TopK の誤差フィードバック
+            vector<uint32_t> _indices;          // TopK の選択用
+            std::mt19937 _engine;
+
+        private:
+            void _compress_topk(const T *, Index, vector<char> &);
+            void _compress_int8(const T *, Index, vector<char> &);
+
+        public:
+            explicit BasicGradientCompressor(const CompressionConfig &config = CompressionConfig());
+
+            void compress(const T *grad, Index n, vector<char> &message);                   // grad[0, n) → message
+            static bool decompress_add(const vector<char> &message, T *out, Index n);       // out[0, n) += 復元した勾配(不正なバイト列なら false)
+            void reset(void) { _residual.resize(0); }                                      // 残差をクリア
+
+            const CompressionConfig &config(void) const { return _config; }
+    };
+
+    extern template class BasicGradientCompressor<double>;
+    extern template class BasicGradientCompressor<float>;
+}
+
+#endif // _GRADIENT_COMPRESSION_H_
@@ -0,0 +1,103 @@
+#include <chrono>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "hogwild_trainer.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    template <typename Scalar>
+    BasicHogwildTrainer<Scalar>::BasicHogwildTrainer(Net &net, const vector<MnistEigenDataset *> &datasets)
+        : _net(&net), _workers(datasets.size()), _pool((int)datasets.size())
+    {
+        for (size_t i = 0; i < datasets.size(); i++){
+            _workers[i].dataset = datasets[i];
+            _workers[i].grads = net.grads; // net.grads と同じ配置
+            _workers[i].X.resize(datasets[i]->batch_size(), net.params.matrix(Net::W1).rows());
+        }
+    }
+
+    template <typename Scalar>
+    HogwildStats BasicHogwildTrainer<Scalar>::run(int steps_per_thread, double learning_rate)
+    {
+        for (Worker &worker : _workers){
+            worker.updates = 0;
+            worker.staleness_sum = 0;
+            worker.staleness_max = 0;
+            worker.loss_sum = 0;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        _pool.parallel_for(num_threads(), [&](int worker_id, int){
+            _run_worker(_workers[worker_id], steps_per_thread, (ComputeScalar)learning_rate);
+        });
+        auto end = std::chrono::steady_clock::now();
+
+        HogwildStats stats;
+        long staleness_sum = 0;
+        double loss_sum = 0;
+        for (const Worker &worker : _workers){
+            stats.updates += worker.updates;
+            staleness_sum += worker.staleness_sum;
+            stats.max_staleness = std::max(stats.max_staleness, worker.staleness_max);
+            loss_sum += worker.loss_sum;
+        }
+        if (stats.updates > 0){
+            stats.mean_staleness = (double)staleness_sum / stats.updates;
+            stats.loss = loss_sum / stats.updates;
+        }
+        stats.seconds = std::chrono::duration<double>(end - start).count();
+
+        return stats;
+    }
+
+    template <typename Scalar>
+    void BasicHogwildTrainer<Scalar>::_run_worker(Worker &worker, int steps, ComputeScalar learning_rate)
+    {
+        for (int step = 0; step < steps; step++){
+            worker.dataset->next_train(worker.X, worker.t, true);
+
+            long read_version = _version.load(std::memory_order_relaxed);
+            TrainStepResult result = _net->forward_backward(worker.X, worker.t, worker.ws, worker.grads);
+            _apply_update(worker, learning_rate);
+            long staleness = _version.fetch_add(1, std::memory_order_relaxed) - read_version;
+
+            worker.updates++;
+            worker.staleness_sum += staleness;
+            worker.staleness_max = std::max(worker.staleness_max, staleness);
+            worker.loss_sum += result.loss;
+        }
+    }
+
+    // ロックなしの更新：W1 は入力が非0の行だけ、b1, W2, b2 は全体
+    template <typename Scalar>
+    void BasicHogwildTrainer<Scalar>::_apply_update(Worker &worker, ComputeScalar learning_rate)
+    {
+        BasicParameterBuffer<Scalar> &params = _net->params;
+        const BasicParameterBuffer<ComputeScalar> &grads = worker.grads;
+
+        worker.active_rows.clear();
+        for (Index i = 0; i < worker.X.cols(); i++){
+            if ((worker.X.col(i).array() != 0).any()){
+                worker.active_rows.push_back((int)i);
+            }
+        }
+
+        auto W1 = params.matrix(Net::W1);
+        auto dW1 = grads.matrix(Net::W1);
+        for (Index j = 0; j < W1.cols(); j++){
+            for (int i : worker.active_rows){
+                W1(i, j) = (Scalar)((ComputeScalar)W1(i, j) - learning_rate * dW1(i, j));
+            }
+        }
+
+        for (int id : {Net::b1, Net::W2, Net::b2}){
+            params.vec(id) = (params.vec(id).template cast<ComputeScalar>() - learning_rate * grads.vec(id)).template cast<Scalar>();
+        }
+    }
+
+    template class BasicHogwildTrainer<double>;
+    template class BasicHogwildTrainer<float>;
+
+}
@@ -0,0 +1,79 @@
+#ifndef _HOGWILD_TRAINER_H_
+#define _HOGWILD_TRAINER_H_
+
+#include <atomic>
+#include <vector>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+#include "thread_pool.h"
+#include "mnist.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // run の集計結果
+    struct HogwildStats{
+        long updates = 0;           // 全スレッドの更新回数
+        double mean_staleness = 0;  // 勾配計算中に他スレッドが行った更新回数の平均
+        long max_staleness = 0;
+        double loss = 0;            // 各更新の損失(更新前の値)の平均
+        double seconds = 0;         // 実行時間
+    };
+
+    // ---------------------------------------------
+    //     Hogwild方式の非同期SGD(ロックなし)
+    // ---------------------------------------------
+    // 各スレッドが自分専用の MnistEigenDataset からバッチを読み出し、共有している net.params を読んで勾配を計算し、
+    // ロックを取らずに直接 params を更新する(スレッド間の同期は run の開始・終了時のみ)。
+    // W1 はバッチ内で入力がすべて0の画素に対応する行の勾配が0になるので、入力が非0の行だけを更新する
+    // (MNISTでは半分程度の行を書かずに済み、スレッド間の書き込みの衝突も減る)。
+    // 読み書きの競合は意図的なもの(古い値や更新途中の値を読んでも学習は収束する、という前提の手法)。
+    // staleness：params を読んでから更新するまでの間に、他スレッドが行った更新の回数。
+    template <typename Scalar>
+    class BasicHogwildTrainer{
+        public:
+            typedef BasicTwoLayerNet<Scalar> Net;
+            typedef typename Net::ComputeScalar ComputeScalar;
+            typedef typename Net::ComputeMatrix ComputeMatrix;
+
+        private:
+            // スレッドごとの状態
+            struct Worker{
+                MnistEigenDataset *dataset;
+                typename Net::Workspace ws;
+                BasicParameterBuffer<ComputeScalar> grads;
+                ComputeMatrix X, t;
+                vector<int> active_rows;    // 入力が非0の画素(W1の更新対象の行)
+                long updates = 0;
+                long staleness_sum = 0;
+                long staleness_max = 0;
+                double loss_sum = 0;
+            };
+
+            Net *_net;
+            vector<Worker> _workers;
+            ThreadPool _pool;
+            std::atomic<long> _version{0}; // 全スレッド通算の更新回数
+
+        private:
+            void _run_worker(Worker &, int, ComputeScalar);
+            void _apply_update(Worker &, ComputeScalar);
+
+        public:
+            // datasets：スレッドごとのデータローダ(スレッド数 = datasets.size()。シードを変えておくこと)
+            BasicHogwildTrainer(Net &net, const vector<MnistEigenDataset *> &datasets);
+
+            HogwildStats run(int steps_per_thread, double learning_rate); // 各スレッドが steps_per_thread 回更新するまで実行
+            int num_threads(void) const { return (int)_workers.size(); }
+    };
+
+    typedef BasicHogwildTrainer<double> HogwildTrainer;
+    typedef BasicHogwildTrainer<float> HogwildTrainerF;
+
+    extern template class BasicHogwildTrainer<double>;
+    extern template class BasicHogwildTrainer<float>;
+}
+
+#endif // _HOGWILD_TRAINER_H_
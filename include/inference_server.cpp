@@ -0,0 +1,372 @@
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "inference_server.h"
+
+namespace MyDL{
+
+    namespace{
+
+        bool read_all(int fd, void *data, size_t size)
+        {
+            char *p = static_cast<char *>(data);
+            while (size > 0){
+                ssize_t n = ::read(fd, p, size);
+                if (n < 0 && errno == EINTR){
+                    continue;
+                }
+                if (n <= 0){
+                    return false;
+                }
+                p += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool write_all(int fd, const void *data, size_t size)
+        {
+            const char *p = static_cast<const char *>(data);
+            while (size > 0){
+                ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR){
+                    continue;
+                }
+                if (n <= 0){
+                    return false;
+                }
+                p += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool make_address(const string &path, sockaddr_un &addr)
+        {
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(addr.sun_path)){
+                return false;
+            }
+            std::strcpy(addr.sun_path, path.c_str());
+            return true;
+        }
+    }
+
+    template <typename Scalar>
+    BasicInferenceServer<Scalar>::BasicInferenceServer(const Net &net, const InferenceServerConfig &config)
+        : _net(&net), _config(config), _latencies_us(LATENCY_SAMPLES), _stats_start(Clock::now())
+    {
+        // 0件のバッチでは何も取り出せずに待ち続けるので、設定は有効な範囲に丸める
+        _config.max_batch_size = std::max(_config.max_batch_size, 1);
+        if (!(_config.max_latency_us >= 0)){
+            _config.max_latency_us = 0;
+        }
+        _input_size = (int)net.params.matrix(Net::W1).rows();
+        _batcher = std::thread(&BasicInferenceServer::_batch_loop, this);
+    }
+
+    template <typename Scalar>
+    BasicInferenceServer<Scalar>::~BasicInferenceServer()
+    {
+        stop_listening();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _batcher.join();
+    }
+
+    template <typename Scalar>
+    std::future<typename BasicInferenceServer<Scalar>::Result> BasicInferenceServer<Scalar>::_enqueue(Request &&request)
+    {
+        std::future<Result> future = request.promise.get_future();
+        bool notify;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            request.arrival = Clock::now();
+            _queue.push_back(std::move(request));
+            // 空のキューに最初の1件が来たとき(待ち開始)と、バッチが埋まったときだけ起こす
+            notify = _queue.size() == 1 || (int)_queue.size() >= _config.max_batch_size;
+        }
+        if (notify){
+            _cv.notify_one();
+        }
+        return future;
+    }
+
+    template <typename Scalar>
+    std::future<typename BasicInferenceServer<Scalar>::Result> BasicInferenceServer<Scalar>::submit(const Ref<const Matrix<ComputeScalar, 1, Dynamic>> &x)
+    {
+        assert(x.cols() == _input_size);
+        Request request;
+        request.x = x;
+        return _enqueue(std::move(request));
+    }
+
+    template <typename Scalar>
+    std::future<typename BasicInferenceServer<Scalar>::Result> BasicInferenceServer<Scalar>::submit(const uint8_t *pixels)
+    {
+        Request request;
+        request.x = Map<const Matrix<uint8_t, 1, Dynamic>>(pixels, _input_size).template cast<ComputeScalar>() / (ComputeScalar)255;
+        return _enqueue(std::move(request));
+    }
+
+    // 先頭のリクエストの到着から max_latency_us 経つか、max_batch_size 件たまるまで待ってまとめて推論
+    template <typename Scalar>
+    void BasicInferenceServer<Scalar>::_batch_loop(void)
+    {
+        typename Net::InferenceWorkspace ws;
+        typename Net::ComputeMatrix X;
+        vector<Request> batch;
+        const auto window = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(_config.max_latency_us));
+
+        while (true){
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this]{ return _stop || !_queue.empty(); });
+                if (_queue.empty()){
+                    return;
+                }
+                Clock::time_point deadline = _queue.front().arrival + window;
+                _cv.wait_until(lock, deadline, [this]{ return _stop || (int)_queue.size() >= _config.max_batch_size; });
+
+                int n = std::min((int)_queue.size(), _config.max_batch_size);
+                batch.clear();
+                for (int i = 0; i < n; i++){
+                    batch.push_back(std::move(_queue.front()));
+                    _queue.pop_front();
+                }
+            }
+
+            const int n = (int)batch.size();
+            X.resize(n, _input_size);
+            for (int i = 0; i < n; i++){
+                X.row(i) = batch[i].x;
+            }
+            const Matrix<ComputeScalar, Dynamic, Dynamic> &Y = _net->infer(X, ws);
+
+            // 集計を先に更新する(結果を受け取ったクライアントが stats を呼んだときに、このバッチが含まれるように)
+            Clock::time_point done = Clock::now();
+            {
+                std::lock_guard<std::mutex> lock(_stats_mutex);
+                for (int i = 0; i < n; i++){
+                    _latencies_us[_requests % LATENCY_SAMPLES] = std::chrono::duration<double, std::micro>(done - batch[i].arrival).count();
+                    _requests++;
+                }
+                _batches++;
+            }
+
+            for (int i = 0; i < n; i++){
+                Result result;
+                Y.row(i).maxCoeff(&result.label);
+                result.probabilities = Y.row(i);
+                batch[i].promise.set_value(std::move(result));
+            }
+        }
+    }
+
+    template <typename Scalar>
+    InferenceServerStats BasicInferenceServer<Scalar>::stats(void)
+    {
+        InferenceServerStats stats;
+        vector<double> latencies;
+        {
+            std::lock_guard<std::mutex> lock(_stats_mutex);
+            stats.requests = _requests;
+            stats.batches = _batches;
+            stats.throughput = _requests / std::chrono::duration<double>(Clock::now() - _stats_start).count();
+            // 直近の分だけコピーする(件数は LATENCY_SAMPLES まで)
+            latencies.assign(_latencies_us.begin(), _latencies_us.begin() + std::min(_requests, (long)LATENCY_SAMPLES));
+        }
+        if (latencies.empty()){
+            return stats;
+        }
+        stats.mean_batch_size = (double)stats.requests / stats.batches;
+
+        auto percentile = [&](double q){
+            size_t k = std::min(latencies.size() - 1, (size_t)(q * latencies.size()));
+            std::nth_element(latencies.begin(), latencies.begin() + k, latencies.end());
+            return latencies[k];
+        };
+        stats.p50_us = percentile(0.5);
+        stats.p99_us = percentile(0.99);
+        return stats;
+    }
+
+    template <typename Scalar>
+    void BasicInferenceServer<Scalar>::reset_stats(void)
+    {
+        std::lock_guard<std::mutex> lock(_stats_mutex);
+        _requests = 0;
+        _batches = 0;
+        _stats_start = Clock::now();
+    }
+
+    // ------------------------------------------------------
+    //        Unixドメインソケット
+    // ------------------------------------------------------
+    template <typename Scalar>
+    bool BasicInferenceServer<Scalar>::listen(const string &socket_path)
+    {
+        sockaddr_un addr;
+        if (_listen_fd >= 0 || !make_address(socket_path, addr)){
+            return false;
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0){
+            return false;
+        }
+        // 前回のソケットが残っていれば消す(ソケット以外のファイルは消さずに失敗する)
+        struct stat st;
+        if (::lstat(socket_path.c_str(), &st) == 0){
+            if (!S_ISSOCK(st.st_mode)){
+                ::close(fd);
+                return false;
+            }
+            ::unlink(socket_path.c_str());
+        }
+        if (::bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(fd, 64) < 0){
+            ::close(fd);
+            return false;
+        }
+        _listen_fd = fd;
+        _socket_path = socket_path;
+        _acceptor = std::thread(&BasicInferenceServer::_accept_loop, this);
+        return true;
+    }
+
+    template <typename Scalar>
+    void BasicInferenceServer<Scalar>::stop_listening(void)
+    {
+        if (_listen_fd < 0){
+            return;
+        }
+        // accept・read で待っているスレッドを起こしてから終了を待つ
+        ::shutdown(_listen_fd, SHUT_RDWR);
+        _acceptor.join();
+        ::close(_listen_fd);
+        _listen_fd = -1;
+        ::unlink(_socket_path.c_str());
+
+        {
+            std::lock_guard<std::mutex> lock(_connections_mutex);
+            for (int fd : _connection_fds){
+                ::shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto &connection : _connections){
+            connection.join();
+        }
+        for (int fd : _connection_fds){
+            ::close(fd);
+        }
+        _connections.clear();
+        _connection_fds.clear();
+        _finished_fds.clear();
+    }
+
+    // 終わった接続のスレッドを join して fd を閉じる(_connections_mutex を取った状態で呼ぶ)
+    template <typename Scalar>
+    void BasicInferenceServer<Scalar>::_reap_connections(void)
+    {
+        for (int fd : _finished_fds){
+            auto it = std::find(_connection_fds.begin(), _connection_fds.end(), fd);
+            size_t i = it - _connection_fds.begin();
+            _connections[i].join(); // _finished_fds に入れた後はロックを取らずに終わるので、すぐに戻る
+            ::close(fd);
+            _connections.erase(_connections.begin() + i);
+            _connection_fds.erase(it);
+        }
+        _finished_fds.clear();
+    }
+
+    template <typename Scalar>
+    void BasicInferenceServer<Scalar>::_accept_loop(void)
+    {
+        while (true){
+            int fd = ::accept(_listen_fd, nullptr, nullptr);
+            if (fd < 0){
+                if (errno == EINTR){
+                    continue;
+                }
+                return; // stop_listening で閉じられた
+            }
+            std::lock_guard<std::mutex> lock(_connections_mutex);
+            _reap_connections();
+            _connection_fds.push_back(fd);
+            _connections.emplace_back(&BasicInferenceServer::_serve_connection, this, fd);
+        }
+    }
+
+    // 1接続分：画素値を受け取るたびに submit し、結果を返す(相手が閉じるまで)
+    template <typename Scalar>
+    void BasicInferenceServer<Scalar>::_serve_connection(int fd)
+    {
+        vector<uint8_t> pixels(_input_size);
+        vector<char> response;
+        while (read_all(fd, pixels.data(), pixels.size())){
+            Result result = submit(pixels.data()).get();
+
+            int32_t label = result.label;
+            Matrix<float, 1, Dynamic> probabilities = result.probabilities.template cast<float>();
+            response.resize(sizeof(label) + probabilities.size() * sizeof(float));
+            std::memcpy(response.data(), &label, sizeof(label));
+            std::memcpy(response.data() + sizeof(label), probabilities.data(), probabilities.size() * sizeof(float));
+            if (!write_all(fd, response.data(), response.size())){
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_connections_mutex);
+        _finished_fds.push_back(fd);
+    }
+
+    bool InferenceClient::connect(const string &socket_path)
+    {
+        sockaddr_un addr;
+        close();
+        if (!make_address(socket_path, addr)){
+            return false;
+        }
+        _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_fd < 0 || ::connect(_fd, (sockaddr *)&addr, sizeof(addr)) < 0){
+            close();
+            return false;
+        }
+        _response.resize(sizeof(int32_t) + _output_size * sizeof(float));
+        return true;
+    }
+
+    void InferenceClient::close(void)
+    {
+        if (_fd >= 0){
+            ::close(_fd);
+        }
+        _fd = -1;
+    }
+
+    bool InferenceClient::classify(const uint8_t *pixels, int &label, float *probabilities)
+    {
+        if (_fd < 0 || !write_all(_fd, pixels, _input_size) || !read_all(_fd, _response.data(), _response.size())){
+            return false;
+        }
+        int32_t value;
+        std::memcpy(&value, _response.data(), sizeof(value));
+        label = value;
+        if (probabilities){
+            std::memcpy(probabilities, _response.data() + sizeof(value), _output_size * sizeof(float));
+        }
+        return true;
+    }
+
+    template class BasicInferenceServer<double>;
+    template class BasicInferenceServer<float>;
+
+}
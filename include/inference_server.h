@@ -0,0 +1,150 @@
+#ifndef _INFERENCE_SERVER_H_
+#define _INFERENCE_SERVER_H_
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <condition_variable>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::string;
+    using std::vector;
+
+    // 動的バッチングの設定(max_batch_size は1未満なら1、max_latency_us は負なら0として扱う)
+    struct InferenceServerConfig{
+        int max_batch_size = 64;        // 1回の推論にまとめる最大リクエスト数
+        double max_latency_us = 200;    // バッチの先頭のリクエストが届いてから、推論を始めるまでに待つ最大時間
+    };
+
+    // 1リクエストの結果
+    template <typename Scalar>
+    struct InferenceResult{
+        int label = -1;
+        Matrix<Scalar, 1, Dynamic> probabilities;   // softmaxの出力
+    };
+
+    // 集計結果(reset_stats からの累計。レイテンシはリクエストの受付から結果の設定までで、
+    // p50 / p99 は直近 BasicInferenceServer::LATENCY_SAMPLES 件から求める)
+    struct InferenceServerStats{
+        long requests = 0;
+        long batches = 0;
+        double mean_batch_size = 0;
+        double p50_us = 0;
+        double p99_us = 0;
+        double throughput = 0;          // リクエスト数 / 経過時間(秒)
+    };
+
+    // ---------------------------------------------
+    //     推論サーバ(動的バッチング)
+    // ---------------------------------------------
+    // 複数のスレッドから1枚ずつ submit された画像をキューにため、
+    // max_batch_size 件たまるか、先頭のリクエストから max_latency_us 経過した時点でまとめて
+    // 1回の行列積(net.infer)で推論し、各リクエストの future に結果を設定する。
+    // listen でUnixドメインソケットからのリクエストも受け付ける
+    // (1リクエスト = 生の画素値 input_size byte → 応答 = ラベル(int32) + 確率(float × output_size))。
+    // net はサーバより長く保持し、サーバの動作中は学習で更新しないこと。
+    template <typename Scalar>
+    class BasicInferenceServer{
+        public:
+            typedef BasicTwoLayerNet<Scalar> Net;
+            typedef typename Net::ComputeScalar ComputeScalar;
+            typedef InferenceResult<ComputeScalar> Result;
+            typedef std::chrono::steady_clock Clock;
+            static const int LATENCY_SAMPLES = 8192; // p50 / p99 の計算に使う直近のレイテンシの件数
+
+        private:
+            struct Request{
+                Matrix<ComputeScalar, 1, Dynamic> x;
+                std::promise<Result> promise;
+                Clock::time_point arrival;
+            };
+
+            const Net *_net;
+            InferenceServerConfig _config;
+            int _input_size;
+
+            std::mutex _mutex;
+            std::condition_variable _cv;
+            std::deque<Request> _queue;
+            bool _stop = false;
+            std::thread _batcher;
+
+            // 集計(_stats_mutex で保護)
+            std::mutex _stats_mutex;
+            vector<double> _latencies_us;   // 直近 LATENCY_SAMPLES 件のリングバッファ(_requests 件目は _requests % LATENCY_SAMPLES に入る)
+            long _requests = 0;
+            long _batches = 0;
+            Clock::time_point _stats_start;
+
+            // Unixドメインソケット
+            int _listen_fd = -1;
+            string _socket_path;
+            std::thread _acceptor;
+            // 接続ごとのスレッドと fd(_connections_mutex で保護)。終わった接続は _finished_fds に fd を入れ、
+            // 次の accept 時(または stop_listening)に join して fd を閉じる
+            std::mutex _connections_mutex;
+            vector<std::thread> _connections;
+            vector<int> _connection_fds;
+            vector<int> _finished_fds;
+
+        private:
+            void _batch_loop(void);
+            void _accept_loop(void);
+            void _serve_connection(int);
+            void _reap_connections(void);
+            std::future<Result> _enqueue(Request &&);
+
+        public:
+            BasicInferenceServer(const Net &net, const InferenceServerConfig &config = InferenceServerConfig());
+            ~BasicInferenceServer(); // キューに残ったリクエストを処理してから終了する
+            BasicInferenceServer(const BasicInferenceServer &) = delete;
+            BasicInferenceServer &operator=(const BasicInferenceServer &) = delete;
+
+            std::future<Result> submit(const Ref<const Matrix<ComputeScalar, 1, Dynamic>> &x); // 正規化済みの1画像(1 × input_size)
+            std::future<Result> submit(const uint8_t *pixels);                                  // 生の画素値(0~255)
+
+            bool listen(const string &socket_path);  // ソケットの受け付けを開始(失敗した場合・socket_path にソケット以外のファイルがある場合はfalse)
+            void stop_listening(void);
+
+            InferenceServerStats stats(void);
+            void reset_stats(void);
+            const InferenceServerConfig &config(void) const { return _config; }
+    };
+
+    // Unixドメインソケット経由のクライアント(1接続 = 1スレッドで使う)
+    class InferenceClient{
+        private:
+            int _fd = -1;
+            int _input_size;
+            int _output_size;
+            vector<char> _response;
+
+        public:
+            InferenceClient(int input_size, int output_size) : _input_size(input_size), _output_size(output_size) {}
+            ~InferenceClient() { close(); }
+            InferenceClient(const InferenceClient &) = delete;
+            InferenceClient &operator=(const InferenceClient &) = delete;
+
+            bool connect(const string &socket_path);
+            void close(void);
+            // 1画像を送って結果を待つ(通信エラーの場合はfalse)。probabilities は nullptr なら受け取らない
+            bool classify(const uint8_t *pixels, int &label, float *probabilities = nullptr);
+    };
+
+    typedef BasicInferenceServer<double> InferenceServer;
+    typedef BasicInferenceServer<float> InferenceServerF;
+
+    extern template class BasicInferenceServer<double>;
+    extern template class BasicInferenceServer<float>;
+}
+
+#endif // _INFERENCE_SERVER_H_
@@ -0,0 +1,168 @@
+#include <Eigen/Dense>
+#include "layers.h"
+#include "gemm.h"
+#include "simple_activation.h"
+#include "simple_loss.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    template <typename Scalar>
+    static void activation_forward_impl(LayerType type, ActivationAccuracy accuracy, const Ref<const Matrix<Scalar, Dynamic, Dynamic>> &x, Ref<Matrix<Scalar, Dynamic, Dynamic>> out)
+    {
+        switch (type){
+        case LayerType::Sigmoid:
+            sigmoid(x, out, accuracy);
+            break;
+        case LayerType::Tanh:
+            tanh_function(x, out, accuracy);
+            break;
+        case LayerType::Relu:
+            relu(x, out);
+            break;
+        default:
+            out = x;
+            break;
+        }
+    }
+
+    template <typename Scalar>
+    static void activation_backward_impl(LayerType type, const Ref<const Matrix<Scalar, Dynamic, Dynamic>> &out, const Ref<const Matrix<Scalar, Dynamic, Dynamic>> &dout,
+                                         Ref<Matrix<Scalar, Dynamic, Dynamic>> dx)
+    {
+        switch (type){
+        case LayerType::Sigmoid:
+            dx = (out.array() * (1 - out.array()) * dout.array()).matrix();
+            break;
+        case LayerType::Tanh:
+            dx = ((1 - out.array().square()) * dout.array()).matrix();
+            break;
+        case LayerType::Relu:
+            dx = (out.array() > 0).select(dout.array(), Scalar(0)).matrix();
+            break;
+        default:
+            dx = dout;
+            break;
+        }
+    }
+
+    void activation_forward(LayerType type, ActivationAccuracy accuracy, const Ref<const MatrixXd> &x, Ref<MatrixXd> out)
+    {
+        activation_forward_impl<double>(type, accuracy, x, out);
+    }
+
+    void activation_forward(LayerType type, ActivationAccuracy accuracy, const Ref<const MatrixXf> &x, Ref<MatrixXf> out)
+    {
+        activation_forward_impl<float>(type, accuracy, x, out);
+    }
+
+    void activation_backward(LayerType type, const Ref<const MatrixXd> &out, const Ref<const MatrixXd> &dout, Ref<MatrixXd> dx)
+    {
+        activation_backward_impl<double>(type, out, dout, dx);
+    }
+
+    void activation_backward(LayerType type, const Ref<const MatrixXf> &out, const Ref<const MatrixXf> &dout, Ref<MatrixXf> dx)
+    {
+        activation_backward_impl<float>(type, out, dout, dx);
+    }
+
+    // ------------------------------------------------------
+    //        Affine層
+    // ------------------------------------------------------
+    template <typename Scalar>
+    BasicAffineLayer<Scalar>::BasicAffineLayer(BasicParameterBuffer<Scalar> *params, BasicParameterBuffer<Scalar> *grads, int W_id, int b_id)
+        : _params(params), _grads(grads), _W_id(W_id), _b_id(b_id)
+    {
+    }
+
+    template <typename Scalar>
+    void BasicAffineLayer<Scalar>::forward(const Ref<const MatrixType> &x)
+    {
+        auto W = _params->matrix(_W_id);
+        auto b = _params->vec(_b_id);
+
+        this->_out.resize(x.rows(), W.cols()); // 同じサイズなら何もしない
+        gemm_noalloc(x, W, this->_out);
+
+        // バイアス加算と活性化：列(バッチ方向に連続)がキャッシュにある間にまとめて行う
+        for (Index j = 0; j < this->_out.cols(); j++){
+            this->_out.col(j).array() += b(j);
+            if (_activation != LayerType::Identity){
+                activation_forward(_activation, _accuracy, this->_out.col(j), this->_out.col(j));
+            }
+        }
+    }
+
+    template <typename Scalar>
+    void BasicAffineLayer<Scalar>::backward(const Ref<const MatrixType> &x, const Ref<const MatrixType> &dout, bool need_dx)
+    {
+        // 活性化を融合している場合は、先に活性化関数の微分を掛ける
+        if (_activation != LayerType::Identity){
+            _delta.resize(dout.rows(), dout.cols());
+            activation_backward(_activation, this->_out, dout, _delta);
+            _backward_affine(x, _delta, need_dx);
+        }
+        else{
+            _backward_affine(x, dout, need_dx);
+        }
+    }
+
+    template <typename Scalar>
+    void BasicAffineLayer<Scalar>::_backward_affine(const Ref<const MatrixType> &x, const Ref<const MatrixType> &delta, bool need_dx)
+    {
+        auto W = _params->matrix(_W_id);
+
+        gemm_noalloc(x.transpose(), delta, _grads->matrix(_W_id));
+        _grads->vec(_b_id) = delta.colwise().sum().transpose();
+        if (need_dx){
+            this->_dx.resize(delta.rows(), W.rows());
+            gemm_noalloc(delta, W.transpose(), this->_dx);
+        }
+    }
+
+    // ------------------------------------------------------
+    //        活性化関数層
+    // ------------------------------------------------------
+    template <typename Scalar>
+    void BasicActivationLayer<Scalar>::forward(const Ref<const MatrixType> &x)
+    {
+        this->_out.resize(x.rows(), x.cols());
+        activation_forward(_type, _accuracy, x, this->_out);
+    }
+
+    template <typename Scalar>
+    void BasicActivationLayer<Scalar>::backward(const Ref<const MatrixType> &, const Ref<const MatrixType> &dout, bool need_dx)
+    {
+        if (need_dx){
+            this->_dx.resize(dout.rows(), dout.cols());
+            activation_backward(_type, this->_out, dout, this->_dx);
+        }
+    }
+
+    // ------------------------------------------------------
+    //        Softmax with Loss 層
+    // ------------------------------------------------------
+    template <typename Scalar>
+    double BasicSoftmaxWithLoss<Scalar>::forward(const Ref<const MatrixType> &x, const Ref<const MatrixType> &t)
+    {
+        _y.resize(x.rows(), x.cols());
+        _dx.resize(x.rows(), x.cols());
+        return softmax_cross_entropy(x, t, _y, _dx);
+    }
+
+    template <typename Scalar>
+    void BasicSoftmaxWithLoss<Scalar>::predict(const Ref<const MatrixType> &x)
+    {
+        _y.resize(x.rows(), x.cols());
+        softmax(x, _y);
+    }
+
+    template class BasicAffineLayer<double>;
+    template class BasicAffineLayer<float>;
+    template class BasicActivationLayer<double>;
+    template class BasicActivationLayer<float>;
+    template class BasicSoftmaxWithLoss<double>;
+    template class BasicSoftmaxWithLoss<float>;
+
+}
@@ -0,0 +1,142 @@
+#ifndef _LAYERS_H_
+#define _LAYERS_H_
+
+#include <Eigen/Dense>
+#include "parameter_buffer.h"
+#include "simple_activation.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    // 層の種類
+    enum class LayerType { Affine, Sigmoid, Relu, Tanh, Identity, SoftmaxWithLoss };
+
+    // 要素ごとの活性化関数の層か(Sigmoid / Relu / Tanh)
+    inline bool is_activation(LayerType type)
+    {
+        return type == LayerType::Sigmoid || type == LayerType::Relu || type == LayerType::Tanh;
+    }
+
+    // ---------------------------------------------
+    //     層の基底クラス
+    // ---------------------------------------------
+    // 順伝播の結果(out)と逆伝播の結果(dx)は層ごとに確保済みのバッファに書き込み、
+    // バッチサイズが変わったときだけ確保し直す。
+    // 入力xは保持しないので、逆伝播時にも順伝播と同じ入力を渡す。
+    // Scalar：計算・パラメータの型(double / float)
+    template <typename Scalar>
+    class BasicLayer{
+        public:
+            typedef Matrix<Scalar, Dynamic, Dynamic> MatrixType;
+
+        protected:
+            MatrixType _out;  // 順伝播の出力
+            MatrixType _dx;   // 逆伝播の出力(入力側への勾配)
+
+        public:
+            virtual ~BasicLayer() {}
+            virtual LayerType type(void) const = 0;
+            virtual void forward(const Ref<const MatrixType> &x) = 0;
+            virtual void backward(const Ref<const MatrixType> &x, const Ref<const MatrixType> &dout, bool need_dx = true) = 0;
+            virtual void set_activation_accuracy(ActivationAccuracy) {}
+            const MatrixType &out(void) const { return _out; }
+            const MatrixType &dx(void) const { return _dx; }
+    };
+
+    typedef BasicLayer<double> Layer;
+
+    // 要素ごとの活性化関数(Affine層への融合にも使う)
+    void activation_forward(LayerType, ActivationAccuracy, const Ref<const MatrixXd> &x, Ref<MatrixXd> out);
+    void activation_forward(LayerType, ActivationAccuracy, const Ref<const MatrixXf> &x, Ref<MatrixXf> out);
+    void activation_backward(LayerType, const Ref<const MatrixXd> &out, const Ref<const MatrixXd> &dout, Ref<MatrixXd> dx); // dx = dout * f'(x) (f'はoutから計算)
+    void activation_backward(LayerType, const Ref<const MatrixXf> &out, const Ref<const MatrixXf> &dout, Ref<MatrixXf> dx);
+
+    // ---------------------------------------------
+    //     Affine層(活性化関数を融合可能)
+    // ---------------------------------------------
+    // out = f(x * W + b)。f が Identity 以外のときは、バイアス加算と活性化を列ごとに1パスで行う。
+    // W, b は ParameterBuffer 内のテンソルIDで参照する(バッファの再確保後も有効)。
+    template <typename Scalar>
+    class BasicAffineLayer : public BasicLayer<Scalar>{
+        public:
+            typedef typename BasicLayer<Scalar>::MatrixType MatrixType;
+
+        private:
+            BasicParameterBuffer<Scalar> *_params;
+            BasicParameterBuffer<Scalar> *_grads;
+            int _W_id;
+            int _b_id;
+            LayerType _activation = LayerType::Identity;
+            ActivationAccuracy _accuracy = ActivationAccuracy::Exact;
+            MatrixType _delta; // dout * f'(x W + b)
+
+        private:
+            void _backward_affine(const Ref<const MatrixType> &x, const Ref<const MatrixType> &delta, bool need_dx);
+
+        public:
+            BasicAffineLayer(BasicParameterBuffer<Scalar> *params, BasicParameterBuffer<Scalar> *grads, int W_id, int b_id);
+            LayerType type(void) const { return LayerType::Affine; }
+            void forward(const Ref<const MatrixType> &x);
+            void backward(const Ref<const MatrixType> &x, const Ref<const MatrixType> &dout, bool need_dx = true);
+
+            void fuse_activation(LayerType activation) { _activation = activation; }
+            LayerType activation(void) const { return _activation; }
+            void set_activation_accuracy(ActivationAccuracy accuracy) { _accuracy = accuracy; }
+    };
+
+    typedef BasicAffineLayer<double> AffineLayer;
+
+    // ---------------------------------------------
+    //     活性化関数層(Sigmoid / Relu / Tanh)
+    // ---------------------------------------------
+    template <typename Scalar>
+    class BasicActivationLayer : public BasicLayer<Scalar>{
+        public:
+            typedef typename BasicLayer<Scalar>::MatrixType MatrixType;
+
+        private:
+            LayerType _type;
+            ActivationAccuracy _accuracy = ActivationAccuracy::Exact;
+
+        public:
+            explicit BasicActivationLayer(LayerType type) : _type(type) {}
+            LayerType type(void) const { return _type; }
+            void forward(const Ref<const MatrixType> &x);
+            void backward(const Ref<const MatrixType> &x, const Ref<const MatrixType> &dout, bool need_dx = true);
+            void set_activation_accuracy(ActivationAccuracy accuracy) { _accuracy = accuracy; }
+    };
+
+    typedef BasicActivationLayer<double> ActivationLayer;
+
+    // ---------------------------------------------
+    //     Softmax with Loss 層(最終層)
+    // ---------------------------------------------
+    // 順伝播で softmax_cross_entropy により損失と勾配(dx)をまとめて求めるので、backward は不要。
+    template <typename Scalar>
+    class BasicSoftmaxWithLoss{
+        public:
+            typedef Matrix<Scalar, Dynamic, Dynamic> MatrixType;
+
+        private:
+            MatrixType _y;
+            MatrixType _dx;
+
+        public:
+            double forward(const Ref<const MatrixType> &x, const Ref<const MatrixType> &t); // 戻り値は損失
+            void predict(const Ref<const MatrixType> &x);                                   // softmaxのみ(損失なし)
+            const MatrixType &y(void) const { return _y; }
+            const MatrixType &dx(void) const { return _dx; }
+    };
+
+    typedef BasicSoftmaxWithLoss<double> SoftmaxWithLoss;
+
+    extern template class BasicAffineLayer<double>;
+    extern template class BasicAffineLayer<float>;
+    extern template class BasicActivationLayer<double>;
+    extern template class BasicActivationLayer<float>;
+    extern template class BasicSoftmaxWithLoss<double>;
+    extern template class BasicSoftmaxWithLoss<float>;
+}
+
+#endif // _LAYERS_H_
@@ -0,0 +1,157 @@
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "model_file.h"
+
+namespace MyDL{
+
+    static const char MODEL_MAGIC[8] = {'M', 'Y', 'D', 'L', 'N', 'E', 'T', '\0'};
+
+    // 8byte単位の FNV-1a(端数は0埋めした1語として扱う)
+    uint64_t model_checksum(const void *data, size_t bytes)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        uint64_t hash = 14695981039346656037ULL;
+        size_t i = 0;
+        for (; i + 8 <= bytes; i += 8){
+            uint64_t word;
+            std::memcpy(&word, p + i, 8);
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+        if (i < bytes){
+            uint64_t word = 0;
+            std::memcpy(&word, p + i, bytes - i);
+            hash = (hash ^ word) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    template <typename Scalar>
+    bool save_model_params(const string &path, const BasicParameterBuffer<Scalar> &params, ActivationAccuracy accuracy)
+    {
+        ModelHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+        header.version = MappedModel::VERSION;
+        header.dtype = (uint32_t)ModelDTypeOf<Scalar>::value;
+        header.input_size = (uint32_t)params.matrix(0).rows();    // W1：入力数 × 隠れ層
+        header.hidden_size = (uint32_t)params.matrix(0).cols();
+        header.output_size = (uint32_t)params.matrix(params.count() - 1).size(); // b2
+        header.activation_accuracy = (uint32_t)accuracy;
+        header.num_tensors = (uint32_t)params.count();
+
+        std::vector<ModelTensorEntry> entries(params.count());
+        for (int i = 0; i < params.count(); i++){
+            std::memset(&entries[i], 0, sizeof(ModelTensorEntry));
+            std::strncpy(entries[i].name, params.name(i).c_str(), sizeof(entries[i].name) - 1);
+            entries[i].offset = (uint64_t)(params.matrix(i).data() - params.data());
+            entries[i].rows = (uint32_t)params.matrix(i).rows();
+            entries[i].cols = (uint32_t)params.matrix(i).cols();
+        }
+
+        size_t table_end = sizeof(header) + entries.size() * sizeof(ModelTensorEntry);
+        header.data_offset = (table_end + MappedModel::DATA_ALIGN - 1) / MappedModel::DATA_ALIGN * MappedModel::DATA_ALIGN;
+        header.data_size = params.size() * sizeof(Scalar);
+        header.checksum = model_checksum(params.data(), header.data_size);
+
+        std::ofstream ofs(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!ofs){
+            return false;
+        }
+        std::vector<char> padding(header.data_offset - table_end, 0);
+        ofs.write((const char *)&header, sizeof(header));
+        ofs.write((const char *)entries.data(), entries.size() * sizeof(ModelTensorEntry));
+        ofs.write(padding.data(), padding.size());
+        ofs.write((const char *)params.data(), header.data_size);
+        ofs.close();
+        return !ofs.fail();
+    }
+
+    bool MappedModel::open(const string &path, bool verify)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0){
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ModelHeader)){
+            ::close(fd);
+            return false;
+        }
+        // MAP_PRIVATE：書き込みはプロセス内のコピーに対して行われる(ファイルは変更されない)
+        void *addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED){
+            return false;
+        }
+        _addr = addr;
+        _length = st.st_size;
+
+        const ModelHeader *header = static_cast<const ModelHeader *>(addr);
+        bool ok = std::memcmp(header->magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) == 0 &&
+                  header->version == VERSION &&
+                  header->activation_accuracy <= (uint32_t)ActivationAccuracy::Fast &&
+                  header->data_offset % DATA_ALIGN == 0 &&
+                  sizeof(ModelHeader) + (size_t)header->num_tensors * sizeof(ModelTensorEntry) <= header->data_offset &&
+                  header->data_offset <= _length && header->data_size <= _length - header->data_offset; // 和はオーバーフローし得るので引き算で比べる
+        if (ok && verify){
+            ok = model_checksum(static_cast<char *>(addr) + header->data_offset, header->data_size) == header->checksum;
+        }
+        if (!ok){
+            close();
+            return false;
+        }
+        _header = header;
+        return true;
+    }
+
+    void MappedModel::close(void)
+    {
+        if (_addr){
+            munmap(_addr, _length);
+        }
+        _addr = nullptr;
+        _length = 0;
+        _header = nullptr;
+    }
+
+    // テンソルの数・名前・形・配置が params と一致していれば、mmap した領域を params に attach する
+    template <typename Scalar>
+    bool attach_model_params(const MappedModel &model, BasicParameterBuffer<Scalar> &params, ActivationAccuracy &accuracy)
+    {
+        if (!model.is_open()){
+            return false;
+        }
+        const ModelHeader &header = model.header();
+        if (header.dtype != (uint32_t)ModelDTypeOf<Scalar>::value || header.num_tensors != (uint32_t)params.count() ||
+            header.data_size != params.size() * sizeof(Scalar)){
+            return false;
+        }
+        for (int i = 0; i < params.count(); i++){
+            const ModelTensorEntry &entry = model.tensor(i);
+            if (params.name(i) != string(entry.name, strnlen(entry.name, sizeof(entry.name))) ||
+                entry.offset != (uint64_t)(params.matrix(i).data() - params.data()) ||
+                entry.rows != params.matrix(i).rows() || entry.cols != params.matrix(i).cols()){
+                return false;
+            }
+        }
+
+        params.attach(static_cast<Scalar *>(model.data()));
+        accuracy = (ActivationAccuracy)header.activation_accuracy;
+        return true;
+    }
+
+    template bool save_model_params<double>(const string &, const BasicParameterBuffer<double> &, ActivationAccuracy);
+    template bool save_model_params<float>(const string &, const BasicParameterBuffer<float> &, ActivationAccuracy);
+    template bool save_model_params<bfloat16>(const string &, const BasicParameterBuffer<bfloat16> &, ActivationAccuracy);
+    template bool attach_model_params<double>(const MappedModel &, BasicParameterBuffer<double> &, ActivationAccuracy &);
+    template bool attach_model_params<float>(const MappedModel &, BasicParameterBuffer<float> &, ActivationAccuracy &);
+    template bool attach_model_params<bfloat16>(const MappedModel &, BasicParameterBuffer<bfloat16> &, ActivationAccuracy &);
+
+}
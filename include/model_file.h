@@ -0,0 +1,118 @@
+#ifndef _MODEL_FILE_H_
+#define _MODEL_FILE_H_
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::string;
+
+    // ---------------------------------------------
+    //     モデルファイル(バイナリ形式・mmap用)
+    // ---------------------------------------------
+    // [ヘッダ(64byte)][テンソル表(32byte × テンソル数)][パディング][パラメータ本体]
+    // パラメータ本体は params.flat() の内容をそのまま書き出したもので、ページ境界(DATA_ALIGN)から始まる。
+    // 各テンソルは ParameterBuffer と同じく ALIGN_SCALARS 要素の境界に揃っているので、
+    // mmap した領域を ParameterBuffer::attach でそのままパラメータとして使える(読み込み・変換なし)。
+    // checksum はパラメータ本体の64bit FNV-1a(8byte単位)。数値はリトルエンディアン。
+    enum class ModelDType : uint32_t { Float64 = 1, Float32 = 2, BFloat16 = 3 };
+
+    template <typename Scalar> struct ModelDTypeOf;
+    template <> struct ModelDTypeOf<double>{ static const ModelDType value = ModelDType::Float64; };
+    template <> struct ModelDTypeOf<float>{ static const ModelDType value = ModelDType::Float32; };
+    template <> struct ModelDTypeOf<bfloat16>{ static const ModelDType value = ModelDType::BFloat16; };
+
+    struct ModelHeader{
+        char magic[8];              // "MYDLNET\0"
+        uint32_t version;
+        uint32_t dtype;             // ModelDType
+        uint32_t input_size;
+        uint32_t hidden_size;
+        uint32_t output_size;
+        uint32_t activation_accuracy;
+        uint32_t num_tensors;
+        uint32_t reserved;
+        uint64_t data_offset;       // ファイル先頭からパラメータ本体までのバイト数
+        uint64_t data_size;         // パラメータ本体のバイト数
+        uint64_t checksum;
+    };
+
+    struct ModelTensorEntry{
+        char name[16];
+        uint64_t offset;            // パラメータ本体の先頭からの要素数
+        uint32_t rows;
+        uint32_t cols;
+    };
+
+    static_assert(sizeof(ModelHeader) == 64, "ModelHeader must be 64 bytes");
+    static_assert(sizeof(ModelTensorEntry) == 32, "ModelTensorEntry must be 32 bytes");
+
+    // モデルファイルを mmap して保持する(コピーオンライトなので、attach したパラメータに書き込んでもファイルは変わらない)
+    class MappedModel{
+        public:
+            static const uint32_t VERSION = 1;
+            static const size_t DATA_ALIGN = 4096;
+
+        private:
+            void *_addr = nullptr;
+            size_t _length = 0;
+            const ModelHeader *_header = nullptr;
+
+        public:
+            MappedModel(){}
+            ~MappedModel() { close(); }
+            MappedModel(const MappedModel &) = delete;
+            MappedModel &operator=(const MappedModel &) = delete;
+
+            // 形式・バージョン・サイズが不正、または verify = true で checksum が一致しない場合はfalse
+            bool open(const string &path, bool verify = true);
+            void close(void);
+            bool is_open(void) const { return _header != nullptr; }
+
+            const ModelHeader &header(void) const { return *_header; }
+            const ModelTensorEntry &tensor(int i) const { return reinterpret_cast<const ModelTensorEntry *>(_header + 1)[i]; }
+            void *data(void) const { return static_cast<char *>(_addr) + _header->data_offset; }
+    };
+
+    uint64_t model_checksum(const void *data, size_t bytes);
+
+    // 内部処理(下の save_model / attach_model から使う)
+    template <typename Scalar>
+    bool save_model_params(const string &, const BasicParameterBuffer<Scalar> &, ActivationAccuracy);
+    template <typename Scalar>
+    bool attach_model_params(const MappedModel &, BasicParameterBuffer<Scalar> &, ActivationAccuracy &);
+
+    // 学習済みのネットワークを保存する(書き込みに失敗した場合はfalse)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    bool save_model(const string &path, const BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> &net)
+    {
+        return save_model_params(path, net.params, net.activation_accuracy());
+    }
+
+    // mmap したモデルのパラメータを net.params として直接使う(model は net より長く保持すること)。
+    // net は同じ次元・同じパラメータ型で構築しておく(一致しない場合はfalse)。
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    bool attach_model(const MappedModel &model, BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> &net)
+    {
+        ActivationAccuracy accuracy;
+        if (!attach_model_params(model, net.params, accuracy)){
+            return false;
+        }
+        net.set_activation_accuracy(accuracy);
+        return true;
+    }
+
+    extern template bool save_model_params<double>(const string &, const BasicParameterBuffer<double> &, ActivationAccuracy);
+    extern template bool save_model_params<float>(const string &, const BasicParameterBuffer<float> &, ActivationAccuracy);
+    extern template bool save_model_params<bfloat16>(const string &, const BasicParameterBuffer<bfloat16> &, ActivationAccuracy);
+    extern template bool attach_model_params<double>(const MappedModel &, BasicParameterBuffer<double> &, ActivationAccuracy &);
+    extern template bool attach_model_params<float>(const MappedModel &, BasicParameterBuffer<float> &, ActivationAccuracy &);
+    extern template bool attach_model_params<bfloat16>(const MappedModel &, BasicParameterBuffer<bfloat16> &, ActivationAccuracy &);
+}
+
+#endif // _MODEL_FILE_H_
@@ -0,0 +1,195 @@
+#include <memory>
+#include <string>
+#include <cassert>
+#include <Eigen/Dense>
+#include "multi_layer_net.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::to_string;
+
+    template <typename Scalar>
+    BasicMultiLayerNet<Scalar>::BasicMultiLayerNet(int input_size, double weight_init_std)
+        : _input_size(input_size), _output_size(input_size), _weight_init_std(weight_init_std)
+    {
+    }
+
+    template <typename Scalar>
+    BasicMultiLayerNet<Scalar>::BasicMultiLayerNet(int input_size, const vector<int> &hidden_sizes, int output_size, LayerType activation, double weight_init_std)
+        : BasicMultiLayerNet(input_size, weight_init_std)
+    {
+        // 不正なサイズ・活性化関数があれば、そこで構築をやめて ok() で知らせる
+        // (飛ばして続けると、活性化関数のない線形層の積み重ねなど別のネットワークになる)
+        for (int hidden_size : hidden_sizes){
+            if (!add_affine(hidden_size) || !add_activation(activation)){
+                _ok = false;
+                return;
+            }
+        }
+        _ok = add_affine(output_size);
+    }
+
+    // Affine層の追加(W, b を params / grads に追加)
+    template <typename Scalar>
+    bool BasicMultiLayerNet<Scalar>::add_affine(int output_size)
+    {
+        if (output_size <= 0){
+            return false;
+        }
+
+        _num_affine++;
+        string index = to_string(_num_affine);
+        int W_id = params.add("W" + index, _output_size, output_size);
+        int b_id = params.add("b" + index, output_size, 1);
+        grads.add("W" + index, _output_size, output_size);
+        grads.add("b" + index, output_size, 1);
+
+        params.matrix(W_id) = (Scalar)_weight_init_std * MatrixType::Random(_output_size, output_size);
+
+        _layers.emplace_back(new BasicAffineLayer<Scalar>(&params, &grads, W_id, b_id));
+        _output_size = output_size;
+        return true;
+    }
+
+    // 活性化関数層の追加：直前がAffine層(活性化なし)ならそこに融合する
+    template <typename Scalar>
+    bool BasicMultiLayerNet<Scalar>::add_activation(LayerType type)
+    {
+        if (!is_activation(type)){
+            return false;
+        }
+
+        if (!_layers.empty() && _layers.back()->type() == LayerType::Affine){
+            BasicAffineLayer<Scalar> *affine = static_cast<BasicAffineLayer<Scalar> *>(_layers.back().get());
+            if (affine->activation() == LayerType::Identity){
+                affine->fuse_activation(type);
+                return true;
+            }
+        }
+        _layers.emplace_back(new BasicActivationLayer<Scalar>(type));
+        return true;
+    }
+
+    template <typename Scalar>
+    void BasicMultiLayerNet<Scalar>::set_activation_accuracy(ActivationAccuracy accuracy)
+    {
+        for (auto &layer : _layers){
+            layer->set_activation_accuracy(accuracy);
+        }
+    }
+
+    // 最終層(SoftmaxWithLoss)の手前までの順伝播
+    template <typename Scalar>
+    void BasicMultiLayerNet<Scalar>::_forward_logits(const Ref<const MatrixType> &X)
+    {
+        assert(!_layers.empty());
+        for (int i = 0; i < (int)_layers.size(); i++){
+            if (i == 0){
+                _layers[i]->forward(X);
+            }
+            else{
+                _layers[i]->forward(_layers[i - 1]->out());
+            }
+        }
+    }
+
+    // 逆伝播(最終層の dx から順にさかのぼる。先頭の層は入力側への勾配を計算しない)
+    template <typename Scalar>
+    void BasicMultiLayerNet<Scalar>::_backward(const Ref<const MatrixType> &X)
+    {
+        const MatrixType *dout = &_last_layer.dx();
+        for (int i = (int)_layers.size() - 1; i >= 0; i--){
+            if (i == 0){
+                _layers[i]->backward(X, *dout, false);
+            }
+            else{
+                _layers[i]->backward(_layers[i - 1]->out(), *dout, true);
+                dout = &_layers[i]->dx();
+            }
+        }
+    }
+
+    template <typename Scalar>
+    const typename BasicMultiLayerNet<Scalar>::MatrixType &BasicMultiLayerNet<Scalar>::predict(const Ref<const MatrixType> &X)
+    {
+        _forward_logits(X);
+        _last_layer.predict(_layers.back()->out());
+
+        return _last_layer.y();
+    }
+
+    template <typename Scalar>
+    double BasicMultiLayerNet<Scalar>::loss(const Ref<const MatrixType> &X, const Ref<const MatrixType> &t)
+    {
+        _forward_logits(X);
+        return _last_layer.forward(_layers.back()->out(), t);
+    }
+
+    template <typename Scalar>
+    double BasicMultiLayerNet<Scalar>::accuracy(const Ref<const MatrixType> &X, const Ref<const MatrixType> &t)
+    {
+        return _batch_accuracy(predict(X), t);
+    }
+
+    // 各行ごとに、最大要素のインデックスを取得 → インデックスが等しければ、accuracyに加算
+    template <typename Scalar>
+    double BasicMultiLayerNet<Scalar>::_batch_accuracy(const MatrixType &y, const Ref<const MatrixType> &t)
+    {
+        Index y_col, t_col;
+        double accuracy = 0;
+        int batch_size = t.rows();
+
+        for (int i = 0; i < batch_size; i++){
+            y.row(i).maxCoeff(&y_col);
+            t.row(i).maxCoeff(&t_col);
+            accuracy += (double)(y_col == t_col);
+        }
+
+        return accuracy / batch_size;
+    }
+
+    template <typename Scalar>
+    const BasicParameterBuffer<Scalar> &BasicMultiLayerNet<Scalar>::gradient(const Ref<const MatrixType> &X, const Ref<const MatrixType> &t)
+    {
+        _forward_logits(X);
+        _last_layer.forward(_layers.back()->out(), t);
+        _backward(X);
+
+        return grads;
+    }
+
+    template <typename Scalar>
+    TrainStepResult BasicMultiLayerNet<Scalar>::train_step(const Ref<const MatrixType> &X, const Ref<const MatrixType> &t, double learning_rate)
+    {
+        TrainStepResult result;
+
+        _forward_logits(X);
+        result.loss = _last_layer.forward(_layers.back()->out(), t);
+        result.accuracy = _batch_accuracy(_last_layer.y(), t);
+
+        _backward(X);
+        params.flat() -= (Scalar)learning_rate * grads.flat(); // 全パラメータが連続領域にあるので1パスで更新
+
+        return result;
+    }
+
+    template <typename Scalar>
+    TrainStepResult BasicMultiLayerNet<Scalar>::train_step(const Ref<const MatrixType> &X, const Ref<const MatrixType> &t, BasicOptimizer<Scalar> &optimizer)
+    {
+        TrainStepResult result;
+
+        _forward_logits(X);
+        result.loss = _last_layer.forward(_layers.back()->out(), t);
+        result.accuracy = _batch_accuracy(_last_layer.y(), t);
+
+        _backward(X);
+        optimizer.update(params, grads);
+
+        return result;
+    }
+
+    template class BasicMultiLayerNet<double>;
+    template class BasicMultiLayerNet<float>;
+
+}
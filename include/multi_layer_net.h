@@ -0,0 +1,84 @@
+#ifndef _MULTI_LAYER_NET_H_
+#define _MULTI_LAYER_NET_H_
+
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+#include "layers.h"
+#include "optimizer.h"
+#include "parameter_buffer.h"
+#include "two_layer_net.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+    using std::unique_ptr;
+
+    // ---------------------------------------------
+    //     多層ニューラルネットワーク(任意の層数)
+    // ---------------------------------------------
+    // add_affine / add_activation で層を積み、最後に SoftmaxWithLoss 層が付く。
+    // Affine層の直後の活性化関数はそのAffine層に融合される(バイアス加算と活性化を1パスで計算)。
+    // パラメータ・勾配は TwoLayerNet と同じく ParameterBuffer にまとめて保持する
+    // (テンソル名は W1, b1, W2, b2, ...)。
+    // Scalar：パラメータ・計算の型(double / float。各層がパラメータを直接参照するので bfloat16 の保持には未対応)
+    template <typename Scalar>
+    class BasicMultiLayerNet{
+        public:
+            typedef Matrix<Scalar, Dynamic, Dynamic> MatrixType;
+
+        private:
+            int _input_size;
+            int _output_size;           // 直前の層の出力サイズ
+            double _weight_init_std;
+            int _num_affine = 0;
+            bool _ok = true;            // 一括構築で不正な引数がなかった
+            vector<unique_ptr<BasicLayer<Scalar>>> _layers;
+            BasicSoftmaxWithLoss<Scalar> _last_layer;
+
+        private:
+            void _forward_logits(const Ref<const MatrixType> &);
+            void _backward(const Ref<const MatrixType> &);
+            double _batch_accuracy(const MatrixType &, const Ref<const MatrixType> &);
+
+        public:
+            BasicParameterBuffer<Scalar> params; // パラメータ
+            BasicParameterBuffer<Scalar> grads;  // 勾配(paramsと同じ配置)
+
+        public:
+            BasicMultiLayerNet(int input_size, double weight_init_std = 0.01);
+            BasicMultiLayerNet(const BasicMultiLayerNet &) = delete;            // 各層が params / grads を参照するのでコピー不可
+            BasicMultiLayerNet &operator=(const BasicMultiLayerNet &) = delete;
+            // 隠れ層のサイズ列と活性化関数を指定して一括で構築(Affine → 活性化 → ... → Affine)
+            // サイズが正でない・activation が活性化関数でない場合は途中で構築をやめ、ok() が false になる
+            BasicMultiLayerNet(int input_size, const vector<int> &hidden_sizes, int output_size,
+                               LayerType activation = LayerType::Sigmoid, double weight_init_std = 0.01);
+
+            // 層の追加(出力サイズが正でない・活性化関数でない種類(Affine / Identity / SoftmaxWithLoss)は追加せずに false)
+            bool add_affine(int output_size);
+            bool add_activation(LayerType type);
+
+            bool ok(void) const { return _ok; }
+            int num_layers(void) const { return (int)_layers.size(); }
+            const BasicLayer<Scalar> &layer(int i) const { return *_layers[i]; }
+
+            // 以下は層が1つ以上あること(空のネットワークは assert で止める)
+            const MatrixType &predict(const Ref<const MatrixType> &);                           // 推論処理
+            double loss(const Ref<const MatrixType> &, const Ref<const MatrixType> &);          // 損失関数
+            double accuracy(const Ref<const MatrixType> &, const Ref<const MatrixType> &);      // 精度
+            const BasicParameterBuffer<Scalar> &gradient(const Ref<const MatrixType> &, const Ref<const MatrixType> &); // 勾配計算(誤差逆伝播法)
+            TrainStepResult train_step(const Ref<const MatrixType> &, const Ref<const MatrixType> &, double); // 順伝播・逆伝播・SGD更新を1回ずつ
+            TrainStepResult train_step(const Ref<const MatrixType> &, const Ref<const MatrixType> &, BasicOptimizer<Scalar> &); // 更新を optimizer で行う版
+
+            void set_activation_accuracy(ActivationAccuracy accuracy);
+    };
+
+    typedef BasicMultiLayerNet<double> MultiLayerNet;
+    typedef BasicMultiLayerNet<float> MultiLayerNetF;
+
+    extern template class BasicMultiLayerNet<double>;
+    extern template class BasicMultiLayerNet<float>;
+}
+
+#endif // _MULTI_LAYER_NET_H_
@@ -0,0 +1,133 @@
+#include <cassert>
+#include <Eigen/Dense>
+#include "multi_process_trainer.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    template <typename Scalar>
+    BasicMultiProcessTrainer<Scalar>::BasicMultiProcessTrainer(Net &net, RingAllReduce &ring, bool overlap)
+        : _net(&net), _ring(&ring), _overlap(overlap)
+    {
+        // rank 0 以外を0にしてから総和を取る = rank 0 のパラメータの配布
+        if (ring.rank() != 0){
+            net.params.setZero();
+        }
+        ring.allreduce(net.params.data(), net.params.size());
+    }
+
+    // 自分のバッチの勾配を計算しつつ通信を登録 → 全プロセスの和をプロセス数で割って net.grads に
+    template <typename Scalar>
+    TrainStepResult BasicMultiProcessTrainer<Scalar>::_compute_gradient(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t)
+    {
+        BasicParameterBuffer<ComputeScalar> &g = _net->grads;
+        const Index split = g.vec(Net::W2).data() - g.data(); // W2 の先頭 = 後ろの層の勾配の開始位置
+        TrainStepResult local;
+
+        if (_compressor.config().type != CompressionType::None){
+            local = _net->forward_backward(X, t, _ws, g);
+            if (!_exchange_compressed()){
+                _failed = true;
+            }
+        }
+        else if (_overlap){
+            // [W2, 末尾) は b2 ができた時点でまとめて、W1 は列ブロックができるたびにその範囲を、
+            // 残りの [W1 の末尾, W2)(b1 と 0 埋め部分)は b1 ができた時点で登録する
+            const Index W1_end = g.vec(Net::W1).data() + g.vec(Net::W1).size() - g.data();
+            assert(g.vec(Net::W1).data() == g.data());
+            local = _net->forward_backward(X, t, _ws, g, [&](int id, Index begin, Index end){
+                if (id == Net::b2){
+                    _ring->allreduce_async(g.data() + split, g.size() - split);
+                }
+                else if (id == Net::W1){
+                    _ring->allreduce_async(g.data() + begin, end - begin);
+                }
+                else if (id == Net::b1){
+                    _ring->allreduce_async(g.data() + W1_end, split - W1_end);
+                }
+            });
+        }
+        else{
+            local = _net->forward_backward(X, t, _ws, g);
+            _ring->allreduce_async(g.data(), g.size());
+        }
+
+        _result[0] = (ComputeScalar)local.loss;
+        _result[1] = (ComputeScalar)local.accuracy;
+        _ring->allreduce_async(_result, 2);
+        if (!_ring->wait()){
+            _failed = true;
+        }
+
+        const ComputeScalar scale = (ComputeScalar)1 / _ring->world_size();
+        g.flat() *= scale;
+
+        TrainStepResult result;
+        result.loss = _result[0] * scale;
+        result.accuracy = _result[1] * scale;
+        return result;
+    }
+
+    // 自分の勾配を圧縮して全プロセスに配り、全プロセス分(自分の分も圧縮したもの)を rank 順に復元して足す
+    // (通信に失敗した・不正なメッセージを受け取った場合は false)
+    template <typename Scalar>
+    bool BasicMultiProcessTrainer<Scalar>::_exchange_compressed(void)
+    {
+        BasicParameterBuffer<ComputeScalar> &g = _net->grads;
+        _compressor.compress(g.data(), g.size(), _message);
+        if (!_ring->allgather(_message, _messages)){
+            return false;
+        }
+
+        g.setZero();
+        for (const vector<char> &message : _messages){
+            if (!BasicGradientCompressor<ComputeScalar>::decompress_add(message, g.data(), g.size())){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Scalar>
+    void BasicMultiProcessTrainer<Scalar>::set_compression(const CompressionConfig &config)
+    {
+        CompressionConfig local = config;
+        local.seed += _ring->rank();
+        _compressor = BasicGradientCompressor<ComputeScalar>(local);
+    }
+
+    template <typename Scalar>
+    const BasicParameterBuffer<typename BasicMultiProcessTrainer<Scalar>::ComputeScalar> &
+    BasicMultiProcessTrainer<Scalar>::gradient(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t)
+    {
+        _compute_gradient(X, t);
+        return _net->grads;
+    }
+
+    template <typename Scalar>
+    TrainStepResult BasicMultiProcessTrainer<Scalar>::train_step(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t, double learning_rate)
+    {
+        TrainStepResult result = _compute_gradient(X, t);
+        if (_failed){
+            return result; // 勾配が揃っていないので更新しない
+        }
+        _net->params.flat() = (_net->params.flat().template cast<ComputeScalar>() - (ComputeScalar)learning_rate * _net->grads.flat()).template cast<Scalar>();
+        return result;
+    }
+
+    template <typename Scalar>
+    TrainStepResult BasicMultiProcessTrainer<Scalar>::train_step(const Ref<const ComputeMatrix> &X, const Ref<const ComputeMatrix> &t, BasicOptimizer<Scalar> &optimizer)
+    {
+        TrainStepResult result = _compute_gradient(X, t);
+        if (_failed){
+            return result;
+        }
+        optimizer.update(_net->params, _net->grads);
+        return result;
+    }
+
+    template class BasicMultiProcessTrainer<double>;
+    template class BasicMultiProcessTrainer<float>;
+
+}
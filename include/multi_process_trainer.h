@@ -0,0 +1,75 @@
+#ifndef _MULTI_PROCESS_TRAINER_H_
+#define _MULTI_PROCESS_TRAINER_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+#include "optimizer.h"
+#include "ring_allreduce.h"
+#include "gradient_compression.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // ---------------------------------------------
+    //     データ並列学習(プロセス並列・リング all-reduce)
+    // ---------------------------------------------
+    // launch_ring_processes で起動した各プロセスが自分のバッチで勾配を計算し、
+    // RingAllReduce で全プロセスの勾配の平均を求めてから同じ更新を行う。
+    // overlap = true のときは、逆伝播で勾配ができた範囲から通信を始め、残りの逆伝播と重ねる
+    // (grads の配置は W1, b1, W2, b2 の順。後ろ側 [W2, 末尾) → W1 の列ブロック(W1_NOTIFY_COLS 列)ごと → b1 の順に登録する)。
+    // 登録した範囲は通信用スレッドが1つずつ順に処理するので、異なる範囲のリングの各段を並行させることはしない。
+    // リングの総和は全プロセスで同じ値になるので、パラメータも全プロセスでビット単位で一致したまま進む。
+    // 全プロセスが同じバッチサイズで、同じ回数だけ train_step を呼ぶこと。
+    // set_compression で圧縮を指定した場合は、逆伝播の後に勾配全体を圧縮して allgather で全プロセスに配り、
+    // 各プロセスが rank 順に復元して足し合わせる(通信と逆伝播は重ならない)。
+    template <typename Scalar>
+    class BasicMultiProcessTrainer{
+        public:
+            typedef BasicTwoLayerNet<Scalar> Net;
+            typedef typename Net::ComputeScalar ComputeScalar;
+            typedef typename Net::ComputeMatrix ComputeMatrix;
+
+        private:
+            Net *_net;
+            RingAllReduce *_ring;
+            bool _overlap;
+            typename Net::Workspace _ws;
+            ComputeScalar _result[2]; // 損失・精度の平均用
+            bool _failed = false;     // 通信エラー・不正なメッセージがあった(以降の train_step は更新しない)
+
+            // 勾配圧縮(type = None のときは使わない)
+            BasicGradientCompressor<ComputeScalar> _compressor;
+            vector<char> _message;
+            vector<vector<char>> _messages;
+
+        private:
+            TrainStepResult _compute_gradient(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &);
+            bool _exchange_compressed(void);
+
+        public:
+            // 構築時に rank 0 のパラメータを全プロセスに配る(全プロセスで同時に構築すること)
+            BasicMultiProcessTrainer(Net &net, RingAllReduce &ring, bool overlap = true);
+
+            bool ok(void) { return _ring->wait() && !_failed; } // 通信エラー・不正なメッセージがなければtrue
+            // 勾配圧縮の設定(全プロセスで同じ設定にすること。seed には rank が足される)
+            void set_compression(const CompressionConfig &config);
+            const CompressionConfig &compression(void) const { return _compressor.config(); }
+            const BasicParameterBuffer<ComputeScalar> &gradient(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &); // 結果は net.grads
+            TrainStepResult train_step(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, double);
+            TrainStepResult train_step(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, BasicOptimizer<Scalar> &);
+
+            int rank(void) const { return _ring->rank(); }
+            int world_size(void) const { return _ring->world_size(); }
+    };
+
+    typedef BasicMultiProcessTrainer<double> MultiProcessTrainer;
+    typedef BasicMultiProcessTrainer<float> MultiProcessTrainerF;
+
+    extern template class BasicMultiProcessTrainer<double>;
+    extern template class BasicMultiProcessTrainer<float>;
+}
+
+#endif // _MULTI_PROCESS_TRAINER_H_
@@ -0,0 +1,182 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "optimizer.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    template <typename Scalar>
+    BasicOptimizer<Scalar>::BasicOptimizer(const OptimizerConfig &config, int num_threads) : _config(config)
+    {
+        if (num_threads != 1){
+            _pool.reset(new ThreadPool(num_threads));
+        }
+    }
+
+    template <typename Scalar>
+    void BasicOptimizer<Scalar>::reset(void)
+    {
+        _step = 0;
+        _m.resize(0);
+        _v.resize(0);
+    }
+
+    // [ステップ数][_m の要素数][_v の要素数][_m][_v](要素数0は未確保)
+    template <typename Scalar>
+    std::vector<char> BasicOptimizer<Scalar>::save_state(void) const
+    {
+        std::vector<char> blob;
+        save_state(blob);
+        return blob;
+    }
+
+    template <typename Scalar>
+    void BasicOptimizer<Scalar>::save_state(std::vector<char> &blob) const
+    {
+        int64_t header[3] = {_step, (int64_t)_m.size(), (int64_t)_v.size()};
+        blob.resize(sizeof(header) + (_m.size() + _v.size()) * sizeof(ComputeScalar));
+        char *p = blob.data();
+        std::memcpy(p, header, sizeof(header));
+        p += sizeof(header);
+        std::memcpy(p, _m.data(), _m.size() * sizeof(ComputeScalar));
+        p += _m.size() * sizeof(ComputeScalar);
+        std::memcpy(p, _v.data(), _v.size() * sizeof(ComputeScalar));
+    }
+
+    template <typename Scalar>
+    bool BasicOptimizer<Scalar>::load_state(const std::vector<char> &blob, Index num_params)
+    {
+        int64_t header[3];
+        if (blob.size() < sizeof(header)){
+            return false;
+        }
+        std::memcpy(header, blob.data(), sizeof(header));
+        // 要素数は掛け算の前にバイト列に収まる範囲か確かめる(壊れた値でオーバーフローさせない)
+        const uint64_t capacity = (blob.size() - sizeof(header)) / sizeof(ComputeScalar);
+        if (header[0] < 0 || header[1] < 0 || header[2] < 0 ||
+            (uint64_t)header[1] > capacity || (uint64_t)header[2] > capacity - (uint64_t)header[1] ||
+            blob.size() != sizeof(header) + (size_t)(header[1] + header[2]) * sizeof(ComputeScalar)){
+            return false;
+        }
+        // 使っていない状態は0要素で保存される。それ以外はパラメータ数と一致すること
+        if ((header[1] != 0 && header[1] != num_params) || (header[2] != 0 && header[2] != num_params)){
+            return false;
+        }
+
+        const char *p = blob.data() + sizeof(header);
+        _step = header[0];
+        _m.resize(header[1]);
+        std::memcpy(_m.data(), p, header[1] * sizeof(ComputeScalar));
+        p += header[1] * sizeof(ComputeScalar);
+        _v.resize(header[2]);
+        std::memcpy(_v.data(), p, header[2] * sizeof(ComputeScalar));
+        return true;
+    }
+
+    template <typename Scalar>
+    void BasicOptimizer<Scalar>::update(BasicParameterBuffer<Scalar> &params, const BasicParameterBuffer<ComputeScalar> &grads)
+    {
+        Index size = params.size();
+        bool use_velocity = _config.type != OptimizerType::SGD;
+        bool use_second_moment = _config.type == OptimizerType::Adam || _config.type == OptimizerType::AdamW;
+
+        if (use_velocity && _m.size() != size){
+            _m = Matrix<ComputeScalar, Dynamic, 1>::Zero(size);
+        }
+        if (use_second_moment && _v.size() != size){
+            _v = Matrix<ComputeScalar, Dynamic, 1>::Zero(size);
+        }
+        _step++;
+
+        // 学習率(Adamはバイアス補正込み)
+        double lr = _config.learning_rate;
+        if (use_second_moment){
+            lr *= std::sqrt(1 - std::pow(_config.beta2, (double)_step)) / (1 - std::pow(_config.beta1, (double)_step));
+        }
+
+        Scalar *p = params.data();
+        const ComputeScalar *g = grads.data();
+        Index num_chunks = (size + CHUNK - 1) / CHUNK;
+
+        if (_pool && size >= PARALLEL_THRESHOLD){
+            _pool->parallel_for((int)num_chunks, [&](int chunk, int){
+                Index begin = chunk * CHUNK;
+                _update_range(p, g, begin, std::min(CHUNK, size - begin), (ComputeScalar)lr);
+            });
+        }
+        else{
+            for (Index begin = 0; begin < size; begin += CHUNK){
+                _update_range(p, g, begin, std::min(CHUNK, size - begin), (ComputeScalar)lr);
+            }
+        }
+    }
+
+    // [begin, begin + n) の範囲を更新する(チャンク内で状態・パラメータをまとめて更新)
+    template <typename Scalar>
+    void BasicOptimizer<Scalar>::_update_range(Scalar *p_data, const ComputeScalar *g_data, Index begin, Index n, ComputeScalar lr)
+    {
+        typedef Array<ComputeScalar, Dynamic, 1> ComputeArray;
+        Map<Array<Scalar, Dynamic, 1>> p(p_data + begin, n);
+        Map<const ComputeArray> g(g_data + begin, n);
+        const ComputeScalar wd = (ComputeScalar)_config.weight_decay;
+        const ComputeScalar mu = (ComputeScalar)_config.momentum;
+
+        // L2正則化(AdamW以外)：勾配に wd * p を加える。wd = 0 のときは勾配をそのまま使う
+        // (bfloat16の場合もここでfloatに変換して計算し、最後に丸める)
+        Array<ComputeScalar, Dynamic, 1, 0, CHUNK, 1> gd;
+        bool decay_grad = wd != 0 && _config.type != OptimizerType::AdamW;
+        if (decay_grad){
+            gd = g + wd * p.template cast<ComputeScalar>();
+        }
+        const Ref<const ComputeArray> grad = decay_grad ? Ref<const ComputeArray>(gd) : Ref<const ComputeArray>(g);
+
+        switch (_config.type){
+        case OptimizerType::SGD:
+            p = (p.template cast<ComputeScalar>() - lr * grad).template cast<Scalar>();
+            break;
+
+        case OptimizerType::Momentum:{
+            Map<ComputeArray> v(_m.data() + begin, n);
+            v = mu * v + grad;
+            p = (p.template cast<ComputeScalar>() - lr * v).template cast<Scalar>();
+            break;
+        }
+
+        case OptimizerType::Nesterov:{
+            Map<ComputeArray> v(_m.data() + begin, n);
+            v = mu * v + grad;
+            p = (p.template cast<ComputeScalar>() - lr * (grad + mu * v)).template cast<Scalar>();
+            break;
+        }
+
+        case OptimizerType::Adam:
+        case OptimizerType::AdamW:{
+            Map<ComputeArray> m(_m.data() + begin, n);
+            Map<ComputeArray> v(_v.data() + begin, n);
+            const ComputeScalar beta1 = (ComputeScalar)_config.beta1;
+            const ComputeScalar beta2 = (ComputeScalar)_config.beta2;
+            const ComputeScalar eps = (ComputeScalar)_config.eps;
+
+            m = beta1 * m + (1 - beta1) * grad;
+            v = beta2 * v + (1 - beta2) * grad.square();
+            if (_config.type == OptimizerType::AdamW && wd != 0){
+                // 減衰はバイアス補正前の学習率で掛ける
+                const ComputeScalar decay = 1 - (ComputeScalar)(_config.learning_rate * _config.weight_decay);
+                p = (decay * p.template cast<ComputeScalar>() - lr * m / (v.sqrt() + eps)).template cast<Scalar>();
+            }
+            else{
+                p = (p.template cast<ComputeScalar>() - lr * m / (v.sqrt() + eps)).template cast<Scalar>();
+            }
+            break;
+        }
+        }
+    }
+
+    template class BasicOptimizer<double>;
+    template class BasicOptimizer<float>;
+    template class BasicOptimizer<bfloat16>;
+
+}
@@ -0,0 +1,81 @@
+#ifndef _OPTIMIZER_H_
+#define _OPTIMIZER_H_
+
+#include <memory>
+#include <vector>
+#include <Eigen/Dense>
+#include "parameter_buffer.h"
+#include "thread_pool.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    enum class OptimizerType { SGD, Momentum, Nesterov, Adam, AdamW };
+
+    // 最適化手法の設定(使わない項目は無視される)
+    struct OptimizerConfig{
+        OptimizerType type = OptimizerType::SGD;
+        double learning_rate = 0.01;
+        double momentum = 0.9;      // Momentum / Nesterov
+        double beta1 = 0.9;         // Adam / AdamW
+        double beta2 = 0.999;
+        double eps = 1e-8;
+        double weight_decay = 0;    // SGD系・Adam：勾配に加える(L2正則化)、AdamW：パラメータから直接減衰させる
+    };
+
+    // ---------------------------------------------
+    //     最適化手法(パラメータ・勾配・状態の一括更新)
+    // ---------------------------------------------
+    // params.flat() / grads.flat() と状態ベクトル(速度・1次/2次モーメント)を CHUNK 要素ずつ区切り、
+    // 各チャンクがキャッシュにある間に状態の更新とパラメータの更新をまとめて行う(Eigenの式でSIMD化)。
+    // パラメータ数が PARALLEL_THRESHOLD 以上のときはチャンクをスレッドに分配する。
+    // 状態は最初の update で params と同じ配置・サイズで確保する。
+    //   SGD      : p -= lr * g
+    //   Momentum : v = mu * v + g,  p -= lr * v
+    //   Nesterov : v = mu * v + g,  p -= lr * (g + mu * v)
+    //   Adam     : m = b1 * m + (1 - b1) * g,  v = b2 * v + (1 - b2) * g^2,  p -= lr_t * m / (sqrt(v) + eps)
+    //   AdamW    : Adam の更新に加えて p -= lr * wd * p (勾配とは独立に減衰)
+    template <typename Scalar>
+    class BasicOptimizer{
+        public:
+            typedef typename NetScalarTraits<Scalar>::Compute ComputeScalar;
+            static const Index CHUNK = 4096;
+            static const Index PARALLEL_THRESHOLD = 1 << 18;
+
+        private:
+            OptimizerConfig _config;
+            long _step = 0;
+            Matrix<ComputeScalar, Dynamic, 1> _m; // 速度(Momentum/Nesterov) または 1次モーメント(Adam)
+            Matrix<ComputeScalar, Dynamic, 1> _v; // 2次モーメント(Adam)
+            std::unique_ptr<ThreadPool> _pool;
+
+        private:
+            void _update_range(Scalar *, const ComputeScalar *, Index, Index, ComputeScalar);
+
+        public:
+            explicit BasicOptimizer(const OptimizerConfig &config = OptimizerConfig(), int num_threads = 1); // num_threads = 0：ハードウェアのスレッド数
+            void update(BasicParameterBuffer<Scalar> &params, const BasicParameterBuffer<ComputeScalar> &grads);
+            void reset(void); // 状態をクリア
+
+            const OptimizerConfig &config(void) const { return _config; }
+            void set_learning_rate(double learning_rate) { _config.learning_rate = learning_rate; }
+            long step(void) const { return _step; }
+
+            // 状態(ステップ数・速度・モーメント)の保存・復元(チェックポイント用)
+            std::vector<char> save_state(void) const;
+            void save_state(std::vector<char> &) const; // 既存の領域を再利用して書き込む版
+            // 形式が合わない場合や、速度・モーメントの要素数が num_params(パラメータ数)でも0でもない場合はfalse(状態は変更しない)
+            bool load_state(const std::vector<char> &, Index num_params);
+    };
+
+    typedef BasicOptimizer<double> Optimizer;
+    typedef BasicOptimizer<float> OptimizerF;
+    typedef BasicOptimizer<bfloat16> OptimizerBF16;
+
+    extern template class BasicOptimizer<double>;
+    extern template class BasicOptimizer<float>;
+    extern template class BasicOptimizer<bfloat16>;
+}
+
+#endif // _OPTIMIZER_H_
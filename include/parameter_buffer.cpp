@@ -0,0 +1,47 @@
+#include "parameter_buffer.h"
+
+namespace MyDL{
+
+    template <typename Scalar>
+    int BasicParameterBuffer<Scalar>::add(const string &name, Index rows, Index cols)
+    {
+        // 直前のテンソルの末尾を境界まで切り上げた位置に配置
+        Index offset = (_size + ALIGN_SCALARS - 1) / ALIGN_SCALARS * ALIGN_SCALARS;
+        Index new_size = offset + rows * cols;
+
+        // 既存の値は保持したまま末尾を0で伸ばす
+        detach();
+        _storage.resize(new_size, Scalar(0));
+        _size = new_size;
+        _version.value.store(_next_version(), std::memory_order_relaxed);
+
+        _entries.push_back({name, offset, rows, cols});
+        return (int)_entries.size() - 1;
+    }
+
+    template <typename Scalar>
+    void BasicParameterBuffer<Scalar>::detach(void)
+    {
+        if (_external){
+            _storage.assign(_external, _external + _size);
+            _external = nullptr;
+            _version.value.store(_next_version(), std::memory_order_relaxed);
+        }
+    }
+
+    template <typename Scalar>
+    int BasicParameterBuffer<Scalar>::id(const string &name) const
+    {
+        for (int i = 0; i < (int)_entries.size(); i++){
+            if (_entries[i].name == name){
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    template class BasicParameterBuffer<double>;
+    template class BasicParameterBuffer<float>;
+    template class BasicParameterBuffer<bfloat16>;
+
+}
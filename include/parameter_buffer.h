@@ -0,0 +1,152 @@
+#ifndef _PARAMETER_BUFFER_H_
+#define _PARAMETER_BUFFER_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <Eigen/Dense>
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::string;
+    using std::vector;
+
+    // パラメータの保持型 → 計算(累積)に使う型
+    // bfloat16 は保持用のみとし、行列積・活性化・勾配はfloatで計算する
+    template <typename Scalar>
+    struct NetScalarTraits{
+        typedef Scalar Compute;
+    };
+
+    template <>
+    struct NetScalarTraits<bfloat16>{
+        typedef float Compute;
+    };
+
+    // 先頭を Align byte 境界に揃えて確保するアロケータ(Eigen の既定の境界は SIMD 幅分までなので、それより大きく揃えたい領域に使う)
+    template <typename T, size_t Align>
+    struct AlignedAllocator{
+        typedef T value_type;
+        template <typename U>
+        struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+        T *allocate(size_t n)
+        {
+            void *p = nullptr;
+            if (posix_memalign(&p, Align, n * sizeof(T)) != 0){
+                throw std::bad_alloc();
+            }
+            return static_cast<T *>(p);
+        }
+        void deallocate(T *p, size_t) { free(p); }
+
+        template <typename U>
+        bool operator==(const AlignedAllocator<U, Align> &) const { return true; }
+        template <typename U>
+        bool operator!=(const AlignedAllocator<U, Align> &) const { return false; }
+    };
+
+    // ---------------------------------------------
+    //     パラメータ(勾配)を1本の連続領域にまとめたバッファ
+    // ---------------------------------------------
+    // 領域の先頭は ALIGN_BYTES 境界に揃えて確保し、各テンソルは ALIGN_SCALARS 要素の境界(float/doubleでは64byte以上)に
+    // 揃えて連続配置して、Eigen::Map で行列として参照する(attach した外部の領域の境界は呼び出し側で揃えること)。
+    // 境界は要素数で固定しているので、要素型が違っても同じ順に add すれば flat() 上の配置は一致する
+    // (bfloat16のパラメータとfloatの勾配を1パスで更新する場合など)。
+    // flat() で全パラメータを1本のベクトルとして扱えるので、最適化は1パスで済む。
+    // 名前での参照(params["W1"])は互換用。頻繁に使う箇所は add の戻り値(ID)で参照する。
+    // version() は非constの参照(書き換えられる可能性がある)を取り出すたびに、プロセス内で一意な値に変わる
+    // (値から作ったコピー(並べ替えた重みなど)を、書き換えがあるまで使い回すときの判定用。
+    //  取り出した Map を保持しておき、後から書き換える場合は判定できないので、書き換える直前に取り出すこと)。
+    template <typename Scalar>
+    class BasicParameterBuffer{
+        public:
+            typedef Matrix<Scalar, Dynamic, Dynamic> MatrixType;
+            typedef Matrix<Scalar, Dynamic, 1> VectorType;
+            static const int ALIGN_SCALARS = 16; // テンソル先頭の境界(要素数)
+            static const int ALIGN_BYTES = 64;   // 領域先頭の境界(byte)
+
+        private:
+            struct Entry{
+                string name;
+                Index offset;
+                Index rows;
+                Index cols;
+            };
+            vector<Entry> _entries;
+            typedef vector<Scalar, AlignedAllocator<Scalar, ALIGN_BYTES>> Storage;
+            Storage _storage;
+            Index _size = 0;
+            Scalar *_external = nullptr; // attach した外部の領域(nullptr なら _storage を使う)
+            // 版(0 は「未確定」で判定に使わない)。Hogwild では複数スレッドが同時に更新するので atomic にし、
+            // コピーしたバッファには新しい版を振る(atomic のままではコピーできないため包む)
+            struct Version{
+                std::atomic<uint64_t> value{0};
+                Version(void) {}
+                Version(const Version &) : value(_next_version()) {}
+                Version &operator=(const Version &) { value.store(_next_version(), std::memory_order_relaxed); return *this; }
+            } _version;
+
+        private:
+            static uint64_t _next_version(void) { static std::atomic<uint64_t> counter(0); return ++counter; }
+            Scalar *_data(void) { _version.value.store(_next_version(), std::memory_order_relaxed); return _external ? _external : _storage.data(); }
+            const Scalar *_data(void) const { return _external ? _external : _storage.data(); }
+
+        public:
+            int add(const string &, Index, Index); // テンソル追加(中身は0初期化, 既存の値は保持)
+            int id(const string &) const;          // 名前 → ID(見つからなければ-1)
+            int count(void) const { return (int)_entries.size(); }
+            const string &name(int i) const { return _entries[i].name; }
+            Index size(void) const { return _size; }
+            uint64_t version(void) const { return _version.value.load(std::memory_order_relaxed); }
+
+            Map<MatrixType> matrix(int i) { return Map<MatrixType>(_data() + _entries[i].offset, _entries[i].rows, _entries[i].cols); }
+            Map<const MatrixType> matrix(int i) const { return Map<const MatrixType>(_data() + _entries[i].offset, _entries[i].rows, _entries[i].cols); }
+            Map<VectorType> vec(int i) { return Map<VectorType>(_data() + _entries[i].offset, _entries[i].rows * _entries[i].cols); }
+            Map<const VectorType> vec(int i) const { return Map<const VectorType>(_data() + _entries[i].offset, _entries[i].rows * _entries[i].cols); }
+            // 固定サイズ行列として参照(Rows, Cols, Size は add したサイズと一致すること。Dynamic なら通常の参照と同じ)
+            template <int Rows, int Cols>
+            Map<Matrix<Scalar, Rows, Cols>> matrix(int i) { return Map<Matrix<Scalar, Rows, Cols>>(_data() + _entries[i].offset, _entries[i].rows, _entries[i].cols); }
+            template <int Rows, int Cols>
+            Map<const Matrix<Scalar, Rows, Cols>> matrix(int i) const { return Map<const Matrix<Scalar, Rows, Cols>>(_data() + _entries[i].offset, _entries[i].rows, _entries[i].cols); }
+            template <int Size>
+            Map<Matrix<Scalar, Size, 1>> vec(int i) { return Map<Matrix<Scalar, Size, 1>>(_data() + _entries[i].offset, _entries[i].rows * _entries[i].cols); }
+            template <int Size>
+            Map<const Matrix<Scalar, Size, 1>> vec(int i) const { return Map<const Matrix<Scalar, Size, 1>>(_data() + _entries[i].offset, _entries[i].rows * _entries[i].cols); }
+            // 名前での参照(存在しない名前は assert で止める)
+            Map<MatrixType> operator[](const string &name) { int i = id(name); assert(i >= 0); return matrix(i); }
+            Map<const MatrixType> operator[](const string &name) const { int i = id(name); assert(i >= 0); return matrix(i); }
+
+            // 全パラメータを1本のベクトルとして参照(テンソル間のパディング(0)も含む)
+            Map<VectorType> flat(void) { return Map<VectorType>(_data(), size()); }
+            Map<const VectorType> flat(void) const { return Map<const VectorType>(_data(), size()); }
+            Scalar *data(void) { return _data(); }
+            const Scalar *data(void) const { return _data(); }
+
+            // 外部の領域(mmapしたモデルファイルなど。同じ配置で size() 要素)を参照するように切り替える。
+            // 自前の領域は解放し、以降の読み書きは外部の領域に対して行う(領域はバッファより長く保持すること)。
+            // コピーしたバッファも同じ外部の領域を参照する。detach で自前の領域にコピーして戻す。
+            void attach(Scalar *data) { Storage().swap(_storage); _external = data; _version.value.store(_next_version(), std::memory_order_relaxed); }
+            void detach(void);
+            bool attached(void) const { return _external != nullptr; }
+
+            void setZero(void) { flat().setZero(); }
+    };
+
+    typedef BasicParameterBuffer<double> ParameterBuffer;
+
+    extern template class BasicParameterBuffer<double>;
+    extern template class BasicParameterBuffer<float>;
+    extern template class BasicParameterBuffer<bfloat16>;
+}
+
+#endif // _PARAMETER_BUFFER_H_
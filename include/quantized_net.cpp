@@ -0,0 +1,251 @@
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "quantized_net.h"
+
+namespace MyDL{
+
+    namespace{
+
+        // C(rows × num_blocks*16, int32, 行優先) = A(rows × K, uint8, 行優先) × B(並べ替え済み int8)
+        typedef void (*QGemmFunc)(const uint8_t *, Index, Index, Index, const int8_t *, Index, int32_t *);
+
+        // 行 a の第 k グループ(入力4個)を1つの32bit値として読む
+        inline uint32_t load_group(const uint8_t *a, Index k)
+        {
+            uint32_t v;
+            std::memcpy(&v, a + k * QuantizedTwoLayerNet::GROUP, sizeof(v));
+            return v;
+        }
+
+        // 末尾の端数のグループ(入力数が GROUP の倍数でない場合)：足りない分は0で埋める
+        inline uint32_t load_tail_group(const uint8_t *a, Index K)
+        {
+            uint32_t v = 0;
+            Index begin = K / QuantizedTwoLayerNet::GROUP * QuantizedTwoLayerNet::GROUP;
+            std::memcpy(&v, a + begin, K - begin);
+            return v;
+        }
+
+        void qgemm_generic(const uint8_t *A, Index rows, Index lda, Index K, const int8_t *B, Index num_blocks, int32_t *C)
+        {
+            const int BLOCK = QuantizedTwoLayerNet::BLOCK;
+            const int GROUP = QuantizedTwoLayerNet::GROUP;
+            const Index num_groups = (K + GROUP - 1) / GROUP;
+            const Index ldc = num_blocks * BLOCK;
+
+            for (Index r = 0; r < rows; r++){
+                const uint8_t *a = A + r * lda;
+                for (Index nb = 0; nb < num_blocks; nb++){
+                    int32_t acc[BLOCK] = {0};
+                    const int8_t *b = B + nb * num_groups * BLOCK * GROUP;
+                    for (Index k = 0; k < num_groups; k++){
+                        uint32_t group = k < K / GROUP ? load_group(a, k) : load_tail_group(a, K);
+                        const uint8_t *x = reinterpret_cast<const uint8_t *>(&group);
+                        for (int j = 0; j < BLOCK; j++){
+                            for (int g = 0; g < GROUP; g++){
+                                acc[j] += (int32_t)x[g] * (int32_t)b[(k * BLOCK + j) * GROUP + g];
+                            }
+                        }
+                    }
+                    std::memcpy(C + r * ldc + nb * BLOCK, acc, sizeof(acc));
+                }
+            }
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        // 4行ずつ処理して、重みの1回の読み出しを4行分の積和に使う
+        __attribute__((target("avx512f,avx512bw,avx512vnni")))
+        void qgemm_avx512vnni(const uint8_t *A, Index rows, Index lda, Index K, const int8_t *B, Index num_blocks, int32_t *C)
+        {
+            const int BLOCK = QuantizedTwoLayerNet::BLOCK;
+            const int GROUP = QuantizedTwoLayerNet::GROUP;
+            const Index num_groups = (K + GROUP - 1) / GROUP;
+            const Index full_groups = K / GROUP;
+            const Index ldc = num_blocks * BLOCK;
+
+            for (Index nb = 0; nb < num_blocks; nb++){
+                const int8_t *b = B + nb * num_groups * BLOCK * GROUP;
+                Index r = 0;
+                for (; r + 4 <= rows; r += 4){
+                    const uint8_t *a0 = A + r * lda;
+                    const uint8_t *a1 = a0 + lda;
+                    const uint8_t *a2 = a1 + lda;
+                    const uint8_t *a3 = a2 + lda;
+                    __m512i c0 = _mm512_setzero_si512();
+                    __m512i c1 = _mm512_setzero_si512();
+                    __m512i c2 = _mm512_setzero_si512();
+                    __m512i c3 = _mm512_setzero_si512();
+                    for (Index k = 0; k < full_groups; k++){
+                        __m512i w = _mm512_loadu_si512(b + k * BLOCK * GROUP);
+                        c0 = _mm512_dpbusd_epi32(c0, _mm512_set1_epi32((int)load_group(a0, k)), w);
+                        c1 = _mm512_dpbusd_epi32(c1, _mm512_set1_epi32((int)load_group(a1, k)), w);
+                        c2 = _mm512_dpbusd_epi32(c2, _mm512_set1_epi32((int)load_group(a2, k)), w);
+                        c3 = _mm512_dpbusd_epi32(c3, _mm512_set1_epi32((int)load_group(a3, k)), w);
+                    }
+                    if (full_groups < num_groups){
+                        __m512i w = _mm512_loadu_si512(b + full_groups * BLOCK * GROUP);
+                        c0 = _mm512_dpbusd_epi32(c0, _mm512_set1_epi32((int)load_tail_group(a0, K)), w);
+                        c1 = _mm512_dpbusd_epi32(c1, _mm512_set1_epi32((int)load_tail_group(a1, K)), w);
+                        c2 = _mm512_dpbusd_epi32(c2, _mm512_set1_epi32((int)load_tail_group(a2, K)), w);
+                        c3 = _mm512_dpbusd_epi32(c3, _mm512_set1_epi32((int)load_tail_group(a3, K)), w);
+                    }
+                    _mm512_storeu_si512(C + (r + 0) * ldc + nb * BLOCK, c0);
+                    _mm512_storeu_si512(C + (r + 1) * ldc + nb * BLOCK, c1);
+                    _mm512_storeu_si512(C + (r + 2) * ldc + nb * BLOCK, c2);
+                    _mm512_storeu_si512(C + (r + 3) * ldc + nb * BLOCK, c3);
+                }
+                for (; r < rows; r++){
+                    const uint8_t *a = A + r * lda;
+                    __m512i c = _mm512_setzero_si512();
+                    for (Index k = 0; k < full_groups; k++){
+                        __m512i w = _mm512_loadu_si512(b + k * BLOCK * GROUP);
+                        c = _mm512_dpbusd_epi32(c, _mm512_set1_epi32((int)load_group(a, k)), w);
+                    }
+                    if (full_groups < num_groups){
+                        __m512i w = _mm512_loadu_si512(b + full_groups * BLOCK * GROUP);
+                        c = _mm512_dpbusd_epi32(c, _mm512_set1_epi32((int)load_tail_group(a, K)), w);
+                    }
+                    _mm512_storeu_si512(C + r * ldc + nb * BLOCK, c);
+                }
+            }
+        }
+#endif
+
+        // 実行時のCPU判定(初回のみ)
+        QGemmFunc select_qgemm(void)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")){
+                return qgemm_avx512vnni;
+            }
+#endif
+            return qgemm_generic;
+        }
+
+        void qgemm(const uint8_t *A, Index rows, Index lda, Index K, const int8_t *B, Index num_blocks, int32_t *C)
+        {
+            static const QGemmFunc kernel = select_qgemm();
+            kernel(A, rows, lda, K, B, num_blocks, C);
+        }
+    }
+
+    const char *quantized_kernel_isa(void)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (select_qgemm() == qgemm_avx512vnni){
+            return "avx512vnni";
+        }
+#endif
+        return "generic";
+    }
+
+    // 列ごとに量子化して VNNI の配置に並べ替える(出力数は BLOCK の倍数まで、入力数は GROUP の倍数まで0埋め)
+    void QuantizedTwoLayerNet::_pack(const MatrixXf &W, int padded_outputs, vector<int8_t> &packed, VectorXf &scale)
+    {
+        const Index K = W.rows();
+        const Index N = W.cols();
+        const Index num_groups = (K + GROUP - 1) / GROUP;
+        const Index num_blocks = padded_outputs / BLOCK;
+
+        packed.assign(num_blocks * num_groups * BLOCK * GROUP, 0);
+        scale.resize(N);
+        for (Index j = 0; j < N; j++){
+            float max_abs = W.col(j).cwiseAbs().maxCoeff();
+            float s = max_abs > 0 ? max_abs / 127 : 1;
+            scale[j] = s / 255; // 入力側(画素値・隠れ層の出力)のスケール 1/255 もまとめる
+
+            const Index nb = j / BLOCK;
+            const Index jj = j % BLOCK;
+            for (Index k = 0; k < K; k++){
+                float q = std::round(W(k, j) / s);
+                packed[((nb * num_groups + k / GROUP) * BLOCK + jj) * GROUP + k % GROUP] = (int8_t)std::max(-127.0f, std::min(127.0f, q));
+            }
+        }
+    }
+
+    void QuantizedTwoLayerNet::quantize(const MatrixXf &W1, const VectorXf &b1, const MatrixXf &W2, const VectorXf &b2)
+    {
+        assert(W1.cols() == W2.rows() && W1.cols() == b1.size() && W2.cols() == b2.size());
+        _input_size = (int)W1.rows();
+        _hidden_size = (int)W1.cols();
+        _output_size = (int)W2.cols();
+        _hidden_padded = (_hidden_size + BLOCK - 1) / BLOCK * BLOCK;
+        _output_padded = (_output_size + BLOCK - 1) / BLOCK * BLOCK;
+
+        _pack(W1, _hidden_padded, _W1, _scale1);
+        // 2層目の入力は隠れ層の出力(_hidden_padded 列、余りは0)なので、重みの行も0埋めして合わせる
+        MatrixXf W2_padded = MatrixXf::Zero(_hidden_padded, _output_size);
+        W2_padded.topRows(_hidden_size) = W2;
+        _pack(W2_padded, _output_padded, _W2, _scale2);
+        _b1 = b1;
+        _b2 = b2;
+    }
+
+    // 整数行列積 → 逆量子化(float) → sigmoid → 量子化 → 整数行列積 → 逆量子化(ws.a2 にロジット)
+    void QuantizedTwoLayerNet::_forward_logits(const Ref<const ImageMatrixXu8> &X, QuantizedInferenceWorkspace &ws) const
+    {
+        assert(X.cols() == _input_size);
+        const Index batch_size = X.rows();
+        const Index max_outputs = std::max(_hidden_padded, _output_padded);
+        if (ws.acc.rows() != batch_size || ws.acc.cols() != max_outputs){
+            ws.acc.resize(batch_size, max_outputs);
+        }
+        if (ws.z1.rows() != batch_size || ws.z1.cols() != _hidden_padded){
+            ws.z1 = ImageMatrixXu8::Zero(batch_size, _hidden_padded); // 余りの列は0のまま使う
+        }
+
+        // affine layer 1
+        qgemm(X.data(), batch_size, X.outerStride(), _input_size, _W1.data(), _hidden_padded / BLOCK, ws.acc.data());
+        Map<const Matrix<int32_t, Dynamic, Dynamic, RowMajor>> acc1(ws.acc.data(), batch_size, _hidden_padded);
+        ws.a1.resize(batch_size, _hidden_size);
+        ws.a1 = (acc1.leftCols(_hidden_size).cast<float>() * _scale1.asDiagonal()).rowwise() + _b1.transpose();
+        // sigmoid layer(結果は 0~1 → 0~255 に量子化)
+        sigmoid(ws.a1, ws.a1, _activation_accuracy);
+        ws.z1.leftCols(_hidden_size) = (ws.a1.array() * 255.0f + 0.5f).cast<uint8_t>();
+
+        // affine layer 2
+        qgemm(ws.z1.data(), batch_size, _hidden_padded, _hidden_padded, _W2.data(), _output_padded / BLOCK, ws.acc.data());
+        Map<const Matrix<int32_t, Dynamic, Dynamic, RowMajor>> acc2(ws.acc.data(), batch_size, _output_padded);
+        ws.a2.resize(batch_size, _output_size);
+        ws.a2 = (acc2.leftCols(_output_size).cast<float>() * _scale2.asDiagonal()).rowwise() + _b2.transpose();
+    }
+
+    const MatrixXf &QuantizedTwoLayerNet::infer(const Ref<const ImageMatrixXu8> &X, QuantizedInferenceWorkspace &ws) const
+    {
+        _forward_logits(X, ws);
+        ws.y.resize(ws.a2.rows(), ws.a2.cols());
+        softmax(ws.a2, ws.y);
+        return ws.y;
+    }
+
+    const MatrixXf &QuantizedTwoLayerNet::infer(const Ref<const ImageMatrixXu8> &X) const
+    {
+        static thread_local QuantizedInferenceWorkspace ws;
+        return infer(X, ws);
+    }
+
+    // softmax は単調なのでロジットの最大値で判定
+    void QuantizedTwoLayerNet::infer_argmax(const Ref<const ImageMatrixXu8> &X, Ref<VectorXi> labels, QuantizedInferenceWorkspace &ws) const
+    {
+        assert(labels.size() == X.rows());
+        _forward_logits(X, ws);
+        for (Index i = 0; i < ws.a2.rows(); i++){
+            Index label;
+            ws.a2.row(i).maxCoeff(&label);
+            labels[i] = (int)label;
+        }
+    }
+
+    void QuantizedTwoLayerNet::infer_argmax(const Ref<const ImageMatrixXu8> &X, Ref<VectorXi> labels) const
+    {
+        static thread_local QuantizedInferenceWorkspace ws;
+        infer_argmax(X, labels, ws);
+    }
+
+}
@@ -0,0 +1,81 @@
+#ifndef _QUANTIZED_NET_H_
+#define _QUANTIZED_NET_H_
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+#include "mnist.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // int8推論の作業領域(呼び出し側またはスレッドごとに持つ。バッチサイズは任意)
+    struct QuantizedInferenceWorkspace{
+        Matrix<int32_t, Dynamic, Dynamic, RowMajor> acc;   // 整数行列積の結果(バッチ × 出力数(16の倍数))
+        MatrixXf a1, a2, y;                                 // 逆量子化後の値・softmaxの出力
+        ImageMatrixXu8 z1;                                  // 隠れ層の出力の量子化値(0~255、列は16の倍数まで0埋め)
+    };
+
+    // ---------------------------------------------
+    //     int8量子化推論(学習後の量子化)
+    // ---------------------------------------------
+    // W1, W2 を出力ユニット(列)ごとのスケール s_j = max|W(:, j)| / 127 で int8 に量子化し、
+    // 入力(生の画素値 0~255)・隠れ層の出力(sigmoid を 0~255 に量子化)との uint8 × int8 → int32 の行列積で推論する。
+    // 行列積の結果に s_j / 255 を掛けて逆量子化し、バイアス・sigmoid・softmax は float で計算する。
+    // 重みは VNNI 命令(vpdpbusd：uint8 × int8 を4個ずつ int32 に積和)の形に並べ替えて保持する
+    //   [出力16個のブロック][入力4個のグループ][16][4]
+    // AVX-512 VNNI が使えるCPUでは実行時に選択し、それ以外は同じ配置の汎用実装で計算する(結果は一致する)。
+    class QuantizedTwoLayerNet{
+        public:
+            static const int BLOCK = 16;    // 1命令で計算する出力数
+            static const int GROUP = 4;     // 1命令で積和する入力数
+
+        private:
+            int _input_size = 0;
+            int _hidden_size = 0;
+            int _output_size = 0;
+            int _hidden_padded = 0;         // BLOCK の倍数(2層目の入力数も兼ねる)
+            int _output_padded = 0;
+            vector<int8_t> _W1;             // 並べ替え済みの量子化重み
+            vector<int8_t> _W2;
+            VectorXf _scale1, _scale2;      // 逆量子化の係数(s_j / 255)
+            VectorXf _b1, _b2;
+            ActivationAccuracy _activation_accuracy = ActivationAccuracy::Exact;
+
+        private:
+            static void _pack(const MatrixXf &, int, vector<int8_t> &, VectorXf &);
+            void _forward_logits(const Ref<const ImageMatrixXu8> &, QuantizedInferenceWorkspace &) const;
+
+        public:
+            QuantizedTwoLayerNet(){}
+            template <typename Scalar, int In, int Hidden, int Out, int Batch>
+            explicit QuantizedTwoLayerNet(const BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> &net)
+            {
+                typedef BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> Net;
+                quantize(net.params.matrix(Net::W1).template cast<float>(), net.params.vec(Net::b1).template cast<float>(),
+                         net.params.matrix(Net::W2).template cast<float>(), net.params.vec(Net::b2).template cast<float>());
+                _activation_accuracy = net.activation_accuracy();
+            }
+
+            // float の重みから量子化(W1：入力数 × 隠れ層, W2：隠れ層 × 出力数)
+            void quantize(const MatrixXf &W1, const VectorXf &b1, const MatrixXf &W2, const VectorXf &b2);
+
+            // X：生の画素値(1行 = 1画像。MnistEigenDataset::test_images_raw() などをそのまま渡せる)
+            const MatrixXf &infer(const Ref<const ImageMatrixXu8> &X, QuantizedInferenceWorkspace &ws) const; // softmaxの出力
+            const MatrixXf &infer(const Ref<const ImageMatrixXu8> &X) const;
+            void infer_argmax(const Ref<const ImageMatrixXu8> &X, Ref<VectorXi> labels, QuantizedInferenceWorkspace &ws) const; // 予測ラベルのみ
+            void infer_argmax(const Ref<const ImageMatrixXu8> &X, Ref<VectorXi> labels) const;
+
+            void set_activation_accuracy(ActivationAccuracy accuracy) { _activation_accuracy = accuracy; }
+            int input_size(void) const { return _input_size; }
+            int hidden_size(void) const { return _hidden_size; }
+            int output_size(void) const { return _output_size; }
+    };
+
+    const char *quantized_kernel_isa(void); // 選ばれた整数行列積カーネル("avx512vnni" / "generic")
+}
+
+#endif // _QUANTIZED_NET_H_
@@ -0,0 +1,292 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include "ring_allreduce.h"
+
+namespace MyDL{
+
+    RingAllReduce::RingAllReduce(int rank, int world_size, int send_fd, int recv_fd)
+        : _rank(rank), _world_size(world_size), _send_fd(send_fd), _recv_fd(recv_fd)
+    {
+        // 送受信を同時に進めるため(両隣が同時に送信してもデッドロックしないように)ノンブロッキングにする
+        if (_world_size > 1){
+            fcntl(_send_fd, F_SETFL, fcntl(_send_fd, F_GETFL) | O_NONBLOCK);
+            fcntl(_recv_fd, F_SETFL, fcntl(_recv_fd, F_GETFL) | O_NONBLOCK);
+        }
+        _worker = std::thread(&RingAllReduce::_worker_loop, this);
+    }
+
+    RingAllReduce::~RingAllReduce()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _worker.join();
+    }
+
+    void RingAllReduce::_worker_loop(void)
+    {
+        while (true){
+            std::function<bool(void)> job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cv.wait(lock, [this]{ return _stop || !_jobs.empty(); });
+                if (_jobs.empty()){
+                    return;
+                }
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+
+            bool ok = _failed ? false : job(); // 一度失敗したら以降の通信は行わない(相手との順序がずれるため)
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _failed = _failed || !ok;
+                _pending--;
+            }
+            _cv.notify_all();
+        }
+    }
+
+    // 右隣への送信と左隣からの受信を同時に進める
+    bool RingAllReduce::_exchange(const void *send_data, size_t send_bytes, void *recv_data, size_t recv_bytes)
+    {
+        const char *send_ptr = static_cast<const char *>(send_data);
+        char *recv_ptr = static_cast<char *>(recv_data);
+        size_t sent = 0;
+        size_t received = 0;
+
+        while (sent < send_bytes || received < recv_bytes){
+            pollfd fds[2];
+            int num_fds = 0;
+            if (sent < send_bytes){
+                fds[num_fds++] = {_send_fd, POLLOUT, 0};
+            }
+            if (received < recv_bytes){
+                fds[num_fds++] = {_recv_fd, POLLIN, 0};
+            }
+            if (poll(fds, num_fds, -1) < 0){
+                if (errno == EINTR){
+                    continue;
+                }
+                return false;
+            }
+
+            for (int i = 0; i < num_fds; i++){
+                if (fds[i].revents & (POLLERR | POLLNVAL)){
+                    return false;
+                }
+                if (fds[i].fd == _send_fd && (fds[i].revents & POLLOUT)){
+                    ssize_t n = send(_send_fd, send_ptr + sent, send_bytes - sent, MSG_NOSIGNAL);
+                    if (n < 0 && errno != EAGAIN && errno != EINTR){
+                        return false;
+                    }
+                    sent += std::max<ssize_t>(n, 0);
+                    _bytes_sent += std::max<ssize_t>(n, 0);
+                }
+                else if (fds[i].fd == _recv_fd && (fds[i].revents & (POLLIN | POLLHUP))){
+                    ssize_t n = recv(_recv_fd, recv_ptr + received, recv_bytes - received, 0);
+                    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)){
+                        return false; // 相手が終了した
+                    }
+                    received += std::max<ssize_t>(n, 0);
+                }
+            }
+        }
+        return true;
+    }
+
+    // n 要素を world_size 個の区間に分け、
+    //   reduce-scatter：world_size-1 回、区間 (rank - s) を送って区間 (rank - s - 1) を受け取り、自分の値に足す
+    //   all-gather    ：world_size-1 回、総和が揃った区間 (rank + 1 - s) を送って区間 (rank - s) を受け取る
+    template <typename T>
+    bool RingAllReduce::_allreduce_chunk(T *data, size_t n)
+    {
+        const int p = _world_size;
+        auto seg_begin = [&](int k){ return n * (size_t)k / p; };
+        auto seg_size = [&](int k){ return seg_begin(k + 1) - seg_begin(k); };
+        auto wrap = [&](int k){ return ((k % p) + p) % p; };
+
+        _recv_buffer.resize((n / p + 1) * sizeof(T));
+        T *recv = reinterpret_cast<T *>(_recv_buffer.data());
+
+        for (int s = 0; s < p - 1; s++){
+            int send_seg = wrap(_rank - s);
+            int recv_seg = wrap(_rank - s - 1);
+            if (!_exchange(data + seg_begin(send_seg), seg_size(send_seg) * sizeof(T), recv, seg_size(recv_seg) * sizeof(T))){
+                return false;
+            }
+            T *dst = data + seg_begin(recv_seg);
+            for (size_t i = 0; i < seg_size(recv_seg); i++){
+                dst[i] += recv[i];
+            }
+        }
+
+        for (int s = 0; s < p - 1; s++){
+            int send_seg = wrap(_rank + 1 - s);
+            int recv_seg = wrap(_rank - s);
+            if (!_exchange(data + seg_begin(send_seg), seg_size(send_seg) * sizeof(T), data + seg_begin(recv_seg), seg_size(recv_seg) * sizeof(T))){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // CHUNK 要素ずつに分けて登録(前のチャンクの通信中に次を待たせておける)
+    template <typename T>
+    void RingAllReduce::_enqueue(T *data, size_t n)
+    {
+        if (_world_size <= 1){
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (size_t begin = 0; begin < n; begin += CHUNK){
+            size_t size = std::min(CHUNK, n - begin);
+            _jobs.push_back([this, data, begin, size]{ return _allreduce_chunk(data + begin, size); });
+            _pending++;
+        }
+        _cv.notify_all();
+    }
+
+    void RingAllReduce::allreduce_async(double *data, size_t n) { _enqueue(data, n); }
+    void RingAllReduce::allreduce_async(float *data, size_t n) { _enqueue(data, n); }
+
+    bool RingAllReduce::wait(void)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]{ return _pending == 0; });
+        return !_failed;
+    }
+
+    bool RingAllReduce::allreduce(double *data, size_t n)
+    {
+        allreduce_async(data, n);
+        return wait();
+    }
+
+    bool RingAllReduce::allreduce(float *data, size_t n)
+    {
+        allreduce_async(data, n);
+        return wait();
+    }
+
+    // p - 1 回、前回受け取ったバイト列(最初は自分のもの)を右隣に送り、左隣から次のバイト列を受け取る。
+    // 長さが可変なので、先にバイト数を交換してから本体を交換する
+    bool RingAllReduce::_allgather(const std::vector<char> &local, std::vector<std::vector<char>> &messages)
+    {
+        const int p = _world_size;
+        messages.resize(p);
+        messages[_rank] = local;
+
+        for (int s = 0; s < p - 1; s++){
+            const std::vector<char> &send_message = messages[(_rank - s + p) % p];
+            std::vector<char> &recv_message = messages[(_rank - s - 1 + p) % p];
+            uint64_t send_size = send_message.size();
+            uint64_t recv_size = 0;
+            if (!_exchange(&send_size, sizeof(send_size), &recv_size, sizeof(recv_size))){
+                return false;
+            }
+            recv_message.resize(recv_size);
+            if (!_exchange(send_message.data(), send_size, recv_message.data(), recv_size)){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool RingAllReduce::allgather(const std::vector<char> &local, std::vector<std::vector<char>> &messages)
+    {
+        if (_world_size <= 1){
+            messages.assign(1, local);
+            return true;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.push_back([this, &local, &messages]{ return _allgather(local, messages); });
+            _pending++;
+        }
+        _cv.notify_all();
+        return wait();
+    }
+
+    size_t RingAllReduce::bytes_sent(void)
+    {
+        wait();
+        return _bytes_sent;
+    }
+
+    // ------------------------------------------------------
+    //        プロセス起動
+    // ------------------------------------------------------
+    bool launch_ring_processes(int world_size, const std::function<int(RingAllReduce &)> &fn)
+    {
+        // links[i]：rank i → rank i+1 の接続([0]が送信側, [1]が受信側)
+        std::vector<std::vector<int>> links(world_size, std::vector<int>(2, -1));
+        for (int i = 0; i < world_size && world_size > 1; i++){
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0){
+                std::cerr << "socketpair failed: " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            links[i][0] = fds[0];
+            links[i][1] = fds[1];
+        }
+
+        std::vector<pid_t> pids;
+        for (int rank = 0; rank < world_size; rank++){
+            pid_t pid = fork();
+            if (pid < 0){
+                std::cerr << "fork failed: " << std::strerror(errno) << std::endl;
+                break;
+            }
+            if (pid == 0){
+                // 子プロセス：自分の送信側(links[rank][0])と受信側(links[rank-1][1])以外は閉じる
+                int send_fd = -1, recv_fd = -1;
+                if (world_size > 1){
+                    int left = (rank + world_size - 1) % world_size;
+                    send_fd = links[rank][0];
+                    recv_fd = links[left][1];
+                    for (int i = 0; i < world_size; i++){
+                        if (links[i][0] != send_fd) close(links[i][0]);
+                        if (links[i][1] != recv_fd) close(links[i][1]);
+                    }
+                }
+
+                int code;
+                {
+                    RingAllReduce ring(rank, world_size, send_fd, recv_fd);
+                    code = fn(ring);
+                }
+                std::cout.flush();
+                _exit(code);
+            }
+            pids.push_back(pid);
+        }
+
+        for (auto &link : links){
+            for (int fd : link){
+                if (fd >= 0) close(fd);
+            }
+        }
+
+        bool ok = (int)pids.size() == world_size;
+        for (pid_t pid : pids){
+            int status = 0;
+            waitpid(pid, &status, 0);
+            ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        return ok;
+    }
+
+}
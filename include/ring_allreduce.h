@@ -0,0 +1,83 @@
+#ifndef _RING_ALLREDUCE_H_
+#define _RING_ALLREDUCE_H_
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+namespace MyDL{
+
+    // ---------------------------------------------
+    //     プロセス間のリング all-reduce
+    // ---------------------------------------------
+    // world_size 個のプロセスを Unix ドメインソケットでリング状につなぎ(rank → rank+1)、
+    // reduce-scatter → all-gather の順に隣のプロセスとだけ通信して総和を求める。
+    // 各プロセスの送受信量はデータ量の約2倍で、プロセス数によらない。
+    // allreduce_async で登録した範囲は通信用スレッドが CHUNK 要素ずつ順に処理するので、
+    // 逆伝播で勾配ができた層から登録すれば、残りの層の計算と通信が重なる。
+    class RingAllReduce{
+        public:
+            static const size_t CHUNK = 1 << 16; // 1回のリング all-reduce で扱う要素数
+
+        private:
+            int _rank;
+            int _world_size;
+            int _send_fd;   // 右隣(rank + 1)への送信
+            int _recv_fd;   // 左隣(rank - 1)からの受信
+            bool _failed = false;
+            size_t _bytes_sent = 0;  // 送信したバイト数の累計(通信用スレッドのみが更新)
+
+            // 通信用スレッドと、その処理待ちの仕事
+            std::thread _worker;
+            std::mutex _mutex;
+            std::condition_variable _cv;
+            std::deque<std::function<bool(void)>> _jobs;
+            int _pending = 0;
+            bool _stop = false;
+
+            std::vector<char> _recv_buffer;
+
+        private:
+            void _worker_loop(void);
+            bool _exchange(const void *, size_t, void *, size_t);
+            template <typename T>
+            bool _allreduce_chunk(T *, size_t);
+            template <typename T>
+            void _enqueue(T *, size_t);
+            bool _allgather(const std::vector<char> &, std::vector<std::vector<char>> &);
+
+        public:
+            RingAllReduce(int rank, int world_size, int send_fd, int recv_fd);
+            ~RingAllReduce();
+            RingAllReduce(const RingAllReduce &) = delete;
+            RingAllReduce &operator=(const RingAllReduce &) = delete;
+
+            int rank(void) const { return _rank; }
+            int world_size(void) const { return _world_size; }
+
+            // data[0, n) を全プロセスの総和で置き換える(全プロセスが同じ順番・同じサイズで呼ぶこと)
+            bool allreduce(double *data, size_t n);
+            bool allreduce(float *data, size_t n);
+            // 非同期版：通信用スレッドに登録してすぐ戻る。wait で登録済みの分が終わるまで待つ
+            void allreduce_async(double *data, size_t n);
+            void allreduce_async(float *data, size_t n);
+            bool wait(void); // 通信エラーがあった場合はfalse
+
+            // 各プロセスの可変長のバイト列を全プロセスに集める(messages[rank] に rank のバイト列が入る)
+            // 圧縮した勾配のように、足し合わせる前に復元が必要なデータの交換に使う
+            bool allgather(const std::vector<char> &local, std::vector<std::vector<char>> &messages);
+
+            size_t bytes_sent(void); // このプロセスが送信したバイト数の累計(登録済みの通信が終わるまで待つ)
+    };
+
+    // world_size 個のプロセスを fork で起動し、リング状のソケットでつないで各プロセスで fn を実行する。
+    // fn の戻り値がプロセスの終了コードになる。全プロセスが0で終了した場合のみtrue。
+    // (fork するので、スレッドを起動する前に呼ぶこと)
+    bool launch_ring_processes(int world_size, const std::function<int(RingAllReduce &)> &fn);
+}
+
+#endif // _RING_ALLREDUCE_H_
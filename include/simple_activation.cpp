@@ -0,0 +1,282 @@
+#include <cmath>
+#include <cstring>
+#include <Eigen/Dense>
+#include "simple_activation.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+
+    // ------------------------------------------------------
+    //   ベクトル化した活性化関数(多項式近似 + 実行時CPU判定)
+    // ------------------------------------------------------
+    // exp(x) = 2^n * exp(r) (x = n*ln2 + r, |r| <= ln2/2) と分解し、exp(r) をテイラー多項式で近似する。
+    //   ActivationAccuracy::High → 6次 (相対誤差 ~1e-7, floatでは丸め誤差程度)
+    //   ActivationAccuracy::Fast → 4次 (相対誤差 ~1e-4)
+    // GCCのベクトル拡張で書き、AVX-512 / AVX2 / SSE2 向けにそれぞれコンパイルしたものを実行時に選ぶ。
+    namespace
+    {
+        enum class KernelOp { Exp, Sigmoid, Tanh };
+
+        // 型ごとの定数(exp の範囲縮小用)
+        template <typename T>
+        struct ExpConstants;
+
+        template <>
+        struct ExpConstants<double>{
+            typedef long long Int;
+            static constexpr double shifter = 6755399441055744.0; // 1.5 * 2^52：加えると整数部分が仮数の下位ビットに入る
+            static constexpr double log2e = 1.4426950408889634;
+            static constexpr double ln2_hi = 0.6931471803691238;  // ln2は上位・下位に分けて誤差を抑える
+            static constexpr double ln2_lo = 1.9082149292705877e-10;
+            static constexpr double lo = -708.0;                  // オーバーフロー・アンダーフローしない範囲
+            static constexpr double hi = 709.0;
+            static constexpr int bias = 1023;
+            static constexpr int mantissa_bits = 52;
+        };
+
+        template <>
+        struct ExpConstants<float>{
+            typedef int Int;
+            static constexpr float shifter = 12582912.0f;         // 1.5 * 2^23
+            static constexpr float log2e = 1.44269504f;
+            static constexpr float ln2_hi = 0.693359375f;
+            static constexpr float ln2_lo = -2.12194440e-4f;
+            static constexpr float lo = -87.0f;
+            static constexpr float hi = 88.0f;
+            static constexpr int bias = 127;
+            static constexpr int mantissa_bits = 23;
+        };
+
+        template <typename T>
+        using KernelFunc = void (*)(KernelOp, ActivationAccuracy, const T *, T *, Index);
+
+#if defined(__GNUC__)
+#define MYDL_ALWAYS_INLINE inline __attribute__((always_inline))
+
+        // Bytes：ベクトルレジスタの幅(AVX-512なら64)
+        template <typename T, int Bytes>
+        struct VecType{
+            static const int width = Bytes / sizeof(T);
+            typedef T d __attribute__((vector_size(Bytes)));
+            typedef typename ExpConstants<T>::Int i __attribute__((vector_size(Bytes)));
+        };
+
+        // x ← exp(x)
+        template <typename T, int Bytes, int Degree>
+        MYDL_ALWAYS_INLINE void exp_poly(typename VecType<T, Bytes>::d &x)
+        {
+            typedef typename VecType<T, Bytes>::d vd;
+            typedef typename VecType<T, Bytes>::i vi;
+            typedef ExpConstants<T> C;
+
+            vd lo = x * 0 + C::lo, hi = x * 0 + C::hi;
+            x = x < lo ? lo : x;
+            x = x > hi ? hi : x;
+
+            // x = n*ln2 + r
+            vd t = x * C::log2e + C::shifter;
+            vd n = t - C::shifter;
+            vd r = (x - n * C::ln2_hi) - n * C::ln2_lo;
+
+            // exp(r) ≒ Σ r^k / k! (ホーナー法)
+            T inv_factorial[Degree + 1];
+            inv_factorial[0] = 1;
+            for (int k = 1; k <= Degree; k++){
+                inv_factorial[k] = inv_factorial[k - 1] / k;
+            }
+            vd p = r * 0 + inv_factorial[Degree];
+            for (int k = Degree - 1; k >= 0; k--){
+                p = p * r + inv_factorial[k];
+            }
+
+            // 2^n は指数部のビットを直接組み立てる
+            vi bits = ((vi)t + C::bias) << C::mantissa_bits;
+            x = p * (vd)bits;
+        }
+
+        template <typename T, int Bytes, int Degree, KernelOp Op>
+        MYDL_ALWAYS_INLINE void apply_op(typename VecType<T, Bytes>::d &x)
+        {
+            if (Op == KernelOp::Exp){
+                exp_poly<T, Bytes, Degree>(x);
+            }
+            else if (Op == KernelOp::Sigmoid){
+                x = -x;
+                exp_poly<T, Bytes, Degree>(x);
+                x = (T)1 / ((T)1 + x);
+            }
+            else{
+                // tanh(x) = 2 * sigmoid(2x) - 1
+                x = (T)-2 * x;
+                exp_poly<T, Bytes, Degree>(x);
+                x = (T)2 / ((T)1 + x) - (T)1;
+            }
+        }
+
+        template <typename T, int Bytes, int Degree, KernelOp Op>
+        MYDL_ALWAYS_INLINE void run_kernel(const T *x, T *y, Index n)
+        {
+            typedef typename VecType<T, Bytes>::d vd;
+            const int width = VecType<T, Bytes>::width;
+            vd v;
+            Index i = 0;
+
+            for (; i + width <= n; i += width){
+                std::memcpy(&v, x + i, Bytes);
+                apply_op<T, Bytes, Degree, Op>(v);
+                std::memcpy(y + i, &v, Bytes);
+            }
+
+            // 端数は0埋めしたベクトルで計算して必要な分だけ書き戻す
+            if (i < n){
+                v = v * 0;
+                std::memcpy(&v, x + i, (n - i) * sizeof(T));
+                apply_op<T, Bytes, Degree, Op>(v);
+                std::memcpy(y + i, &v, (n - i) * sizeof(T));
+            }
+        }
+
+        template <typename T, int Bytes>
+        MYDL_ALWAYS_INLINE void run_kernel(KernelOp op, ActivationAccuracy accuracy, const T *x, T *y, Index n)
+        {
+            bool fast = (accuracy == ActivationAccuracy::Fast);
+            switch (op){
+            case KernelOp::Exp:
+                fast ? run_kernel<T, Bytes, 4, KernelOp::Exp>(x, y, n) : run_kernel<T, Bytes, 6, KernelOp::Exp>(x, y, n);
+                break;
+            case KernelOp::Sigmoid:
+                fast ? run_kernel<T, Bytes, 4, KernelOp::Sigmoid>(x, y, n) : run_kernel<T, Bytes, 6, KernelOp::Sigmoid>(x, y, n);
+                break;
+            case KernelOp::Tanh:
+                fast ? run_kernel<T, Bytes, 4, KernelOp::Tanh>(x, y, n) : run_kernel<T, Bytes, 6, KernelOp::Tanh>(x, y, n);
+                break;
+            }
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        template <typename T>
+        __attribute__((target("avx512f")))
+        void run_kernel_avx512(KernelOp op, ActivationAccuracy accuracy, const T *x, T *y, Index n)
+        {
+            run_kernel<T, 64>(op, accuracy, x, y, n);
+        }
+
+        template <typename T>
+        __attribute__((target("avx2,fma")))
+        void run_kernel_avx2(KernelOp op, ActivationAccuracy accuracy, const T *x, T *y, Index n)
+        {
+            run_kernel<T, 32>(op, accuracy, x, y, n);
+        }
+#endif
+
+        template <typename T>
+        void run_kernel_generic(KernelOp op, ActivationAccuracy accuracy, const T *x, T *y, Index n)
+        {
+            run_kernel<T, 16>(op, accuracy, x, y, n);
+        }
+
+        // 実行時のCPU判定(初回のみ)
+        template <typename T>
+        KernelFunc<T> select_kernel(void)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")){
+                return run_kernel_avx512<T>;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+                return run_kernel_avx2<T>;
+            }
+#endif
+            return run_kernel_generic<T>;
+        }
+
+        const char *select_kernel_name(void)
+        {
+            KernelFunc<double> kernel = select_kernel<double>();
+#if defined(__x86_64__) || defined(__i386__)
+            if (kernel == run_kernel_avx512<double>){
+                return "avx512";
+            }
+            if (kernel == run_kernel_avx2<double>){
+                return "avx2";
+            }
+#endif
+            return kernel == run_kernel_generic<double> ? "generic" : "unknown";
+        }
+#else
+        // GCC/Clang以外：スカラーで計算
+        template <typename T>
+        void run_kernel_scalar(KernelOp op, ActivationAccuracy, const T *x, T *y, Index n)
+        {
+            for (Index i = 0; i < n; i++){
+                y[i] = op == KernelOp::Exp ? std::exp(x[i]) : op == KernelOp::Sigmoid ? 1 / (1 + std::exp(-x[i])) : std::tanh(x[i]);
+            }
+        }
+
+        template <typename T>
+        KernelFunc<T> select_kernel(void) { return run_kernel_scalar<T>; }
+        const char *select_kernel_name(void) { return "scalar"; }
+#endif
+
+        // 列ごとに連続領域としてカーネルに渡す
+        template <typename T>
+        void apply_columnwise(KernelOp op, ActivationAccuracy accuracy, const Ref<const Matrix<T, Dynamic, Dynamic>> &x, Ref<Matrix<T, Dynamic, Dynamic>> out)
+        {
+            static const KernelFunc<T> kernel = select_kernel<T>();
+            for (Index j = 0; j < x.cols(); j++){
+                kernel(op, accuracy, x.col(j).data(), out.col(j).data(), x.rows());
+            }
+        }
+
+        template <typename T>
+        void exp_impl(const Ref<const Matrix<T, Dynamic, Dynamic>> &x, Ref<Matrix<T, Dynamic, Dynamic>> out, ActivationAccuracy accuracy)
+        {
+            if (accuracy == ActivationAccuracy::Exact){
+                out = x.array().exp();
+            }
+            else{
+                apply_columnwise<T>(KernelOp::Exp, accuracy, x, out);
+            }
+        }
+
+        template <typename T>
+        void sigmoid_impl(const Ref<const Matrix<T, Dynamic, Dynamic>> &x, Ref<Matrix<T, Dynamic, Dynamic>> out, ActivationAccuracy accuracy)
+        {
+            if (accuracy == ActivationAccuracy::Exact){
+                out = x.array().logistic();
+            }
+            else{
+                apply_columnwise<T>(KernelOp::Sigmoid, accuracy, x, out);
+            }
+        }
+
+        template <typename T>
+        void tanh_impl(const Ref<const Matrix<T, Dynamic, Dynamic>> &x, Ref<Matrix<T, Dynamic, Dynamic>> out, ActivationAccuracy accuracy)
+        {
+            if (accuracy == ActivationAccuracy::Exact){
+                out = x.array().tanh();
+            }
+            else{
+                apply_columnwise<T>(KernelOp::Tanh, accuracy, x, out);
+            }
+        }
+    }
+
+    const char *activation_kernel_isa(void)
+    {
+        static const char *name = select_kernel_name();
+        return name;
+    }
+
+    void exp_function(const Ref<const MatrixXd> &x, Ref<MatrixXd> out, ActivationAccuracy accuracy) { exp_impl<double>(x, out, accuracy); }
+    void exp_function(const Ref<const MatrixXf> &x, Ref<MatrixXf> out, ActivationAccuracy accuracy) { exp_impl<float>(x, out, accuracy); }
+    void sigmoid(const Ref<const MatrixXd> &x, Ref<MatrixXd> out, ActivationAccuracy accuracy) { sigmoid_impl<double>(x, out, accuracy); }
+    void sigmoid(const Ref<const MatrixXf> &x, Ref<MatrixXf> out, ActivationAccuracy accuracy) { sigmoid_impl<float>(x, out, accuracy); }
+    void tanh_function(const Ref<const MatrixXd> &x, Ref<MatrixXd> out, ActivationAccuracy accuracy) { tanh_impl<double>(x, out, accuracy); }
+    void tanh_function(const Ref<const MatrixXf> &x, Ref<MatrixXf> out, ActivationAccuracy accuracy) { tanh_impl<float>(x, out, accuracy); }
+    void relu(const Ref<const MatrixXd> &x, Ref<MatrixXd> out) { out = x.cwiseMax(0.0); }
+    void relu(const Ref<const MatrixXf> &x, Ref<MatrixXf> out) { out = x.cwiseMax(0.0f); }
+
+}
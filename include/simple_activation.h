@@ -32,7 +32,7 @@ namespace MyDL{
     }
 
 
-    MatrixXd softmax(MatrixXd x){
+    inline MatrixXd softmax(MatrixXd x){
         VectorXd max_coeff_vec, rowwise_sum;
         max_coeff_vec = x.rowwise().maxCoeff();
 
@@ -44,11 +44,43 @@ namespace MyDL{
         return x;
     }
 
-    MatrixXd sigmoid(MatrixXd x){
+    inline MatrixXd sigmoid(MatrixXd x){
         x = x.unaryExpr([] (double p){return 1 / (1 + exp(-p));});
         return x;
     }
 
+    // 出力先を指定する版(メモリ確保なし：outはxと同じサイズで確保済みであること)
+    template <typename Scalar>
+    void softmax_rows(const Ref<const Matrix<Scalar, Dynamic, Dynamic>> &x, Ref<Matrix<Scalar, Dynamic, Dynamic>> out){
+        for (Index i = 0; i < x.rows(); i++){
+            Scalar max_coeff = x.row(i).maxCoeff();                // expのオーバーフロー回避
+            out.row(i) = (x.row(i).array() - max_coeff).exp();
+            out.row(i) /= out.row(i).sum();                        // 出力の総和が1になるよう調整
+        }
+    }
+
+    inline void softmax(const Ref<const MatrixXd> &x, Ref<MatrixXd> out){ softmax_rows<double>(x, out); }
+    inline void softmax(const Ref<const MatrixXf> &x, Ref<MatrixXf> out){ softmax_rows<float>(x, out); }
+
+    // 活性化関数の精度(Exact以外は多項式近似のベクトル化カーネルを使う)
+    enum class ActivationAccuracy{
+        Exact, // 標準ライブラリ相当
+        High,  // 相対誤差 ~1e-7
+        Fast,  // 相対誤差 ~1e-4
+    };
+
+    // 要素ごとの活性化関数(出力先を指定する版：メモリ確保なし, double / float)
+    // 近似カーネルは実行時にCPUを判定して AVX-512 / AVX2 / SSE2 のいずれかを使う
+    void exp_function(const Ref<const MatrixXd> &x, Ref<MatrixXd> out, ActivationAccuracy accuracy = ActivationAccuracy::Exact);
+    void exp_function(const Ref<const MatrixXf> &x, Ref<MatrixXf> out, ActivationAccuracy accuracy = ActivationAccuracy::Exact);
+    void sigmoid(const Ref<const MatrixXd> &x, Ref<MatrixXd> out, ActivationAccuracy accuracy = ActivationAccuracy::Exact);
+    void sigmoid(const Ref<const MatrixXf> &x, Ref<MatrixXf> out, ActivationAccuracy accuracy = ActivationAccuracy::Exact);
+    void tanh_function(const Ref<const MatrixXd> &x, Ref<MatrixXd> out, ActivationAccuracy accuracy = ActivationAccuracy::Exact);
+    void tanh_function(const Ref<const MatrixXf> &x, Ref<MatrixXf> out, ActivationAccuracy accuracy = ActivationAccuracy::Exact);
+    void relu(const Ref<const MatrixXd> &x, Ref<MatrixXd> out);
+    void relu(const Ref<const MatrixXf> &x, Ref<MatrixXf> out);
+    const char *activation_kernel_isa(void); // 選ばれた近似カーネル("avx512", "avx2", "generic" など)
+
 }
 
 #endif // _SIMPLE_ACTIVATION_H_
\ No newline at end of file
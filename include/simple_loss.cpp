@@ -1,12 +1,62 @@
+#include <algorithm>
 #include <Eigen/Dense>
 #include "simple_loss.h"
 
 namespace MyDL{
 
-    double cross_entropy_error(MatrixXd& y, MatrixXd& t){
+    double cross_entropy_error(const MatrixXd& y, const MatrixXd& t){
         int batch_size = y.rows();
         double ret = (t.array() * y.array().log()).sum() / batch_size;
         return -ret;
     }
 
-}
\ No newline at end of file
+    // 行(サンプル)方向を BLOCK 行ずつに区切り、各ブロック内は列(クラス)ごとにバッチ方向へベクトル化して計算する。
+    // ブロック内の最大値・expの総和はスタック上に置き、ブロックがキャッシュにある間に損失と勾配まで求める。
+    template <typename Scalar>
+    static double softmax_cross_entropy_impl(const Ref<const Matrix<Scalar, Dynamic, Dynamic>>& a, const Ref<const Matrix<Scalar, Dynamic, Dynamic>>& t,
+                                             Ref<Matrix<Scalar, Dynamic, Dynamic>> y, Ref<Matrix<Scalar, Dynamic, Dynamic>> da){
+        const int BLOCK = 64;
+        typedef Array<Scalar, Dynamic, 1, 0, BLOCK, 1> BlockArray;
+
+        Index batch_size = a.rows();
+        Index classes = a.cols();
+        double loss = 0;
+
+        for (Index r = 0; r < batch_size; r += BLOCK){
+            Index n = std::min<Index>(BLOCK, batch_size - r);
+            BlockArray max_coeff(n), sum_exp(n), log_sum_exp(n);
+
+            // 行ごとの最大値(expのオーバーフロー回避)
+            max_coeff = a.col(0).segment(r, n).array();
+            for (Index j = 1; j < classes; j++){
+                max_coeff = max_coeff.max(a.col(j).segment(r, n).array());
+            }
+
+            // exp(a - max) と、その総和
+            sum_exp.setZero();
+            for (Index j = 0; j < classes; j++){
+                y.col(j).segment(r, n).array() = (a.col(j).segment(r, n).array() - max_coeff).exp();
+                sum_exp += y.col(j).segment(r, n).array();
+            }
+            log_sum_exp = max_coeff + sum_exp.log();
+
+            // 損失：-Σ t * log(y) = Σ t * (logΣexp(a) - a)、勾配：(y - t) / バッチサイズ
+            for (Index j = 0; j < classes; j++){
+                loss += (t.col(j).segment(r, n).array() * (log_sum_exp - a.col(j).segment(r, n).array())).sum();
+                y.col(j).segment(r, n).array() /= sum_exp;
+                da.col(j).segment(r, n) = (y.col(j).segment(r, n) - t.col(j).segment(r, n)) / (Scalar)batch_size;
+            }
+        }
+
+        return loss / batch_size;
+    }
+
+    double softmax_cross_entropy(const Ref<const MatrixXd>& a, const Ref<const MatrixXd>& t, Ref<MatrixXd> y, Ref<MatrixXd> da){
+        return softmax_cross_entropy_impl<double>(a, t, y, da);
+    }
+
+    double softmax_cross_entropy(const Ref<const MatrixXf>& a, const Ref<const MatrixXf>& t, Ref<MatrixXf> y, Ref<MatrixXf> da){
+        return softmax_cross_entropy_impl<float>(a, t, y, da);
+    }
+
+}
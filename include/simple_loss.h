@@ -6,8 +6,14 @@
 namespace MyDL{
     using namespace Eigen;
 
-    double cross_entropy_error(MatrixXd&, MatrixXd&);
+    double cross_entropy_error(const MatrixXd&, const MatrixXd&);
+
+    // softmax + 交差エントロピー誤差の順伝播・逆伝播をまとめて計算(メモリ確保なし)
+    // a: ロジット, t: 教師データ(one-hot) → y: softmax出力, da: (y - t) / バッチサイズ, 戻り値: 損失(バッチ平均)
+    // log-sum-exp で損失を求めるので、確率が0に潰れても log(0) にならない
+    double softmax_cross_entropy(const Ref<const MatrixXd>& a, const Ref<const MatrixXd>& t, Ref<MatrixXd> y, Ref<MatrixXd> da);
+    double softmax_cross_entropy(const Ref<const MatrixXf>& a, const Ref<const MatrixXf>& t, Ref<MatrixXf> y, Ref<MatrixXf> da);
 
 }
 
-#endif // _SIMPLE_LOSS_H_
\ No newline at end of file
+#endif // _SIMPLE_LOSS_H_
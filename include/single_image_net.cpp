@@ -0,0 +1,253 @@
+#include <cmath>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "single_image_net.h"
+
+namespace MyDL{
+
+    namespace{
+
+        // out[0, n) += Σ_k val[k] × W(idx[k], 0:n)  (W：行優先、行の長さ ld。idx が nullptr なら idx[k] = k)
+        // n は LANES の倍数
+        typedef void (*GemvFunc)(const int *, const float *, int, const float *, Index, Index, float *);
+
+        void gemv_generic(const int *idx, const float *val, int nnz, const float *W, Index ld, Index n, float *out)
+        {
+            for (int k = 0; k < nnz; k++){
+                const float *w = W + (idx ? idx[k] : k) * ld;
+                const float x = val[k];
+                for (Index j = 0; j < n; j++){
+                    out[j] += x * w[j];
+                }
+            }
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        // 出力 NV × 16 個分の累積をレジスタに置いたまま、入力の全要素を積和する
+        template <int NV>
+        __attribute__((target("avx512f")))
+        void gemv_block_avx512(const int *idx, const float *val, int nnz, const float *W, Index ld, float *out)
+        {
+            __m512 acc[NV];
+            for (int v = 0; v < NV; v++){
+                acc[v] = _mm512_loadu_ps(out + v * 16);
+            }
+            for (int k = 0; k < nnz; k++){
+                const float *w = W + (idx ? idx[k] : k) * ld;
+                const __m512 x = _mm512_set1_ps(val[k]);
+                for (int v = 0; v < NV; v++){
+                    acc[v] = _mm512_fmadd_ps(x, _mm512_loadu_ps(w + v * 16), acc[v]);
+                }
+            }
+            for (int v = 0; v < NV; v++){
+                _mm512_storeu_ps(out + v * 16, acc[v]);
+            }
+        }
+
+        // 出力を 128 個(レジスタ8本)ずつに分けて計算する
+        __attribute__((target("avx512f")))
+        void gemv_avx512(const int *idx, const float *val, int nnz, const float *W, Index ld, Index n, float *out)
+        {
+            for (Index begin = 0; begin < n; begin += 8 * 16){
+                const float *w = W + begin;
+                float *o = out + begin;
+                switch (std::min<Index>(8, (n - begin) / 16)){
+                case 1: gemv_block_avx512<1>(idx, val, nnz, w, ld, o); break;
+                case 2: gemv_block_avx512<2>(idx, val, nnz, w, ld, o); break;
+                case 3: gemv_block_avx512<3>(idx, val, nnz, w, ld, o); break;
+                case 4: gemv_block_avx512<4>(idx, val, nnz, w, ld, o); break;
+                case 5: gemv_block_avx512<5>(idx, val, nnz, w, ld, o); break;
+                case 6: gemv_block_avx512<6>(idx, val, nnz, w, ld, o); break;
+                case 7: gemv_block_avx512<7>(idx, val, nnz, w, ld, o); break;
+                default: gemv_block_avx512<8>(idx, val, nnz, w, ld, o); break;
+                }
+            }
+        }
+
+        // AVX2 版(レジスタ1本 = 8個なので、16 個の列ブロック NV 個をレジスタ 2 × NV 本で計算する)
+        template <int NV>
+        __attribute__((target("avx2,fma")))
+        void gemv_block_avx2(const int *idx, const float *val, int nnz, const float *W, Index ld, float *out)
+        {
+            __m256 acc[2 * NV];
+            for (int v = 0; v < 2 * NV; v++){
+                acc[v] = _mm256_loadu_ps(out + v * 8);
+            }
+            for (int k = 0; k < nnz; k++){
+                const float *w = W + (idx ? idx[k] : k) * ld;
+                const __m256 x = _mm256_set1_ps(val[k]);
+                for (int v = 0; v < 2 * NV; v++){
+                    acc[v] = _mm256_fmadd_ps(x, _mm256_loadu_ps(w + v * 8), acc[v]);
+                }
+            }
+            for (int v = 0; v < 2 * NV; v++){
+                _mm256_storeu_ps(out + v * 8, acc[v]);
+            }
+        }
+
+        // 出力を 64 個(レジスタ8本)ずつに分けて計算する
+        __attribute__((target("avx2,fma")))
+        void gemv_avx2(const int *idx, const float *val, int nnz, const float *W, Index ld, Index n, float *out)
+        {
+            for (Index begin = 0; begin < n; begin += 4 * 16){
+                const float *w = W + begin;
+                float *o = out + begin;
+                switch (std::min<Index>(4, (n - begin) / 16)){
+                case 1: gemv_block_avx2<1>(idx, val, nnz, w, ld, o); break;
+                case 2: gemv_block_avx2<2>(idx, val, nnz, w, ld, o); break;
+                case 3: gemv_block_avx2<3>(idx, val, nnz, w, ld, o); break;
+                default: gemv_block_avx2<4>(idx, val, nnz, w, ld, o); break;
+                }
+            }
+        }
+#endif
+
+        // 実行時のCPU判定(初回のみ)
+        GemvFunc select_gemv(void)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")){
+                return gemv_avx512;
+            }
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")){
+                return gemv_avx2;
+            }
+#endif
+            return gemv_generic;
+        }
+
+        void gemv(const int *idx, const float *val, int nnz, const float *W, Index ld, Index n, float *out)
+        {
+            static const GemvFunc kernel = select_gemv();
+            kernel(idx, val, nnz, W, ld, n, out);
+        }
+    }
+
+    const char *single_image_kernel_isa(void)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        GemvFunc kernel = select_gemv();
+        if (kernel == gemv_avx512){
+            return "avx512";
+        }
+        if (kernel == gemv_avx2){
+            return "avx2";
+        }
+#endif
+        return "generic";
+    }
+
+    // 行優先に並べ替える(列数は padded_cols まで0埋め)
+    void SingleImageTwoLayerNet::_pack(const MatrixXf &W, int padded_cols, vector<float> &packed)
+    {
+        packed.assign(W.rows() * padded_cols, 0.0f);
+        Map<Matrix<float, Dynamic, Dynamic, RowMajor>>(packed.data(), W.rows(), padded_cols).leftCols(W.cols()) = W;
+    }
+
+    bool SingleImageTwoLayerNet::pack(const MatrixXf &W1, const VectorXf &b1, const MatrixXf &W2, const VectorXf &b2)
+    {
+        // classify はスタック上の配列(MAX_*_SIZE)を使うので、収まらないネットワークはここで拒否する
+        _ok = false;
+        _input_size = _hidden_size = _output_size = 0;
+        _hidden_padded = _output_padded = 0;
+        _W1.clear();
+        _W2.clear();
+        _b1.clear();
+        _b2.clear();
+        if (W1.cols() != W2.rows() || W1.cols() != b1.size() || W2.cols() != b2.size()){
+            return false;
+        }
+        if (W1.rows() <= 0 || W1.rows() > MAX_INPUT_SIZE || W1.cols() <= 0 || W1.cols() > MAX_HIDDEN_SIZE ||
+            W2.cols() <= 0 || W2.cols() > MAX_OUTPUT_SIZE){
+            return false;
+        }
+
+        _input_size = (int)W1.rows();
+        _hidden_size = (int)W1.cols();
+        _output_size = (int)W2.cols();
+        _hidden_padded = (_hidden_size + LANES - 1) / LANES * LANES;
+        _output_padded = (_output_size + LANES - 1) / LANES * LANES;
+
+        _pack(W1, _hidden_padded, _W1);
+        _pack(W2, _output_padded, _W2);
+        _b1.assign(_hidden_padded, 0.0f);
+        _b2.assign(_output_padded, 0.0f);
+        std::copy(b1.data(), b1.data() + _hidden_size, _b1.begin());
+        std::copy(b2.data(), b2.data() + _output_size, _b2.begin());
+        _ok = true;
+        return true;
+    }
+
+    // idx / val：入力の非0要素(nnz 個)
+    // affine → sigmoid → affine(→ softmax)をすべてスタック上の配列で計算する
+    int SingleImageTwoLayerNet::_classify(const int *idx, const float *val, int nnz, float *probabilities) const
+    {
+        alignas(64) float h[MAX_HIDDEN_SIZE];
+        alignas(64) float y[MAX_OUTPUT_SIZE];
+
+        // affine layer 1 + sigmoid layer
+        std::copy(_b1.begin(), _b1.end(), h);
+        gemv(idx, val, nnz, _W1.data(), _hidden_padded, _hidden_padded, h);
+        Map<MatrixXf> z1(h, 1, _hidden_size);
+        sigmoid(z1, z1, _activation_accuracy);
+
+        // affine layer 2
+        std::copy(_b2.begin(), _b2.end(), y);
+        gemv(nullptr, h, _hidden_size, _W2.data(), _output_padded, _output_padded, y);
+
+        int label = (int)(std::max_element(y, y + _output_size) - y);
+        if (probabilities){
+            // softmax(オーバーフロー対策に最大値を引く)
+            const float max_logit = y[label];
+            float sum = 0;
+            for (int j = 0; j < _output_size; j++){
+                probabilities[j] = std::exp(y[j] - max_logit);
+                sum += probabilities[j];
+            }
+            for (int j = 0; j < _output_size; j++){
+                probabilities[j] /= sum;
+            }
+        }
+        return label;
+    }
+
+    int SingleImageTwoLayerNet::classify(const uint8_t *pixels, float *probabilities) const
+    {
+        if (!_ok){
+            return -1;
+        }
+        alignas(64) int idx[MAX_INPUT_SIZE];
+        alignas(64) float val[MAX_INPUT_SIZE];
+        int nnz = 0;
+        for (int i = 0; i < _input_size; i++){
+            if (pixels[i] != 0){
+                idx[nnz] = i;
+                val[nnz] = pixels[i] * (1.0f / 255);
+                nnz++;
+            }
+        }
+        return _classify(idx, val, nnz, probabilities);
+    }
+
+    int SingleImageTwoLayerNet::classify(const float *x, float *probabilities) const
+    {
+        if (!_ok){
+            return -1;
+        }
+        alignas(64) int idx[MAX_INPUT_SIZE];
+        alignas(64) float val[MAX_INPUT_SIZE];
+        int nnz = 0;
+        for (int i = 0; i < _input_size; i++){
+            if (x[i] != 0){
+                idx[nnz] = i;
+                val[nnz] = x[i];
+                nnz++;
+            }
+        }
+        return _classify(idx, val, nnz, probabilities);
+    }
+
+}
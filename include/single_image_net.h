@@ -0,0 +1,77 @@
+#ifndef _SINGLE_IMAGE_NET_H_
+#define _SINGLE_IMAGE_NET_H_
+
+#include <cstdint>
+#include <vector>
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // ---------------------------------------------
+    //     1画像専用の推論(行列ベクトル積)
+    // ---------------------------------------------
+    // バッチサイズ1の推論を、動的サイズ行列の行列積を通さずに行列ベクトル積で計算する。
+    // 重みは構築時に float の行優先(1行 = 1入力ユニットの重み、列数は LANES の倍数まで0埋め)に並べ替えて保持し、
+    // 入力の非0要素ごとに「出力ベクトル += x_i × 重みの行 i」を SIMD レジスタ上の累積で計算する
+    // (MNISTの画素は大半が0なので、読む重みの行も少なくなる)。
+    // 途中の値はすべてスタック上の配列に置くので、classify はメモリを確保しない。
+    // AVX-512 / AVX2 が使えるCPUでは実行時に選択し、それ以外は汎用実装で計算する。
+    // 各次元が MAX_*_SIZE を超えるネットワークは pack で拒否する(ok() が false になり、classify は -1 を返す)。
+    class SingleImageTwoLayerNet{
+        public:
+            static const int LANES = 16;        // 1命令で計算する出力数(float)
+            static const int MAX_INPUT_SIZE = 4096;  // スタックに置く配列の大きさ(これを超えるネットワークは扱わない)
+            static const int MAX_HIDDEN_SIZE = 1024;
+            static const int MAX_OUTPUT_SIZE = 256;
+
+        private:
+            int _input_size = 0;
+            int _hidden_size = 0;
+            int _output_size = 0;
+            int _hidden_padded = 0;         // LANES の倍数
+            int _output_padded = 0;
+            bool _ok = false;
+            vector<float> _W1;              // 並べ替え済みの重み(入力数 × _hidden_padded)
+            vector<float> _W2;              // (隠れ層 × _output_padded)
+            vector<float> _b1, _b2;         // 0埋め済みのバイアス
+            ActivationAccuracy _activation_accuracy = ActivationAccuracy::Exact;
+
+        private:
+            static void _pack(const MatrixXf &, int, vector<float> &);
+            int _classify(const int *, const float *, int, float *) const;
+
+        public:
+            SingleImageTwoLayerNet(){}
+            template <typename Scalar, int In, int Hidden, int Out, int Batch>
+            explicit SingleImageTwoLayerNet(const BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> &net)
+            {
+                typedef BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch> Net;
+                pack(net.params.matrix(Net::W1).template cast<float>(), net.params.vec(Net::b1).template cast<float>(),
+                     net.params.matrix(Net::W2).template cast<float>(), net.params.vec(Net::b2).template cast<float>());
+                _activation_accuracy = net.activation_accuracy();
+            }
+
+            // float の重みから並べ替え(W1：入力数 × 隠れ層, W2：隠れ層 × 出力数)
+            // 大きさが合わない場合や MAX_*_SIZE を超える場合は false(空の状態になる)
+            bool pack(const MatrixXf &W1, const VectorXf &b1, const MatrixXf &W2, const VectorXf &b2);
+
+            // 1画像を分類して予測ラベルを返す。probabilities を渡した場合は softmax の出力(output_size 個)も書き込む
+            // (ok() が false の場合は何もせず -1 を返す)
+            int classify(const uint8_t *pixels, float *probabilities = nullptr) const; // 生の画素値(0~255)
+            int classify(const float *x, float *probabilities = nullptr) const;        // 正規化済みの入力
+
+            bool ok(void) const { return _ok; }
+            void set_activation_accuracy(ActivationAccuracy accuracy) { _activation_accuracy = accuracy; }
+            int input_size(void) const { return _input_size; }
+            int hidden_size(void) const { return _hidden_size; }
+            int output_size(void) const { return _output_size; }
+    };
+
+    const char *single_image_kernel_isa(void); // 選ばれた行列ベクトル積カーネル("avx512" / "avx2" / "generic")
+}
+
+#endif // _SINGLE_IMAGE_NET_H_
@@ -0,0 +1,188 @@
+#ifndef _SPARSE_GEMM_H_
+#define _SPARSE_GEMM_H_
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "mnist.h"
+
+namespace MyDL{
+
+    using namespace Eigen;
+    using std::vector;
+
+    // 入力が CSR 形式(SparseImageBatch)の行列積の作業領域(サイズが変わったときだけ確保し直す)
+    template <typename Scalar>
+    struct BasicSparseGemmWorkspace{
+        typedef Matrix<Scalar, Dynamic, Dynamic, RowMajor> RowMatrix;
+        RowMatrix W_rows;                   // 重みの行優先コピー(1行 = 1入力の重み、列はチャンクの倍数まで0埋め)
+        const void *W_source = nullptr;     // W_rows のコピー元の先頭と版(sparse_gemm_noalloc の W_version)
+        uint64_t W_version = 0;
+        RowMatrix out_rows;                 // X * W の結果(行優先)
+        RowMatrix D_rows;                   // Xᵀ * D の D の行優先コピー
+        RowMatrix dW_rows;                  // Xᵀ * D の結果(行優先)
+        vector<int> col_ptr, col_rows, col_next; // X の CSC 形式(画素ごとの非0要素の行と値)
+        vector<Scalar> col_values;
+        Matrix<Scalar, Dynamic, Dynamic> X_dense; // 密な行列積にフォールバックするときの入力
+    };
+
+    namespace sparse_gemm_internal{
+
+        // 出力の1行をレジスタに置いたまま積和する幅(256byte = AVX-512 なら4レジスタ)
+        template <typename Scalar>
+        struct Chunk{
+            static const int size = 256 / sizeof(Scalar);
+            typedef Matrix<Scalar, 1, size> Type;
+            typedef Map<const Type> ConstMap;
+        };
+
+        const Index COPY_TILE = 16;
+
+        // dst = src (行優先 ⇔ 列優先の変換を含む)。タイルごとにコピーして、書き込み(読み出し)が飛び飛びになるのを防ぐ
+        template <typename Src, typename Dst>
+        void copy_tiled(const Src &src, Dst &&dst)
+        {
+            typedef typename std::decay<Dst>::type::Scalar Scalar;
+            const Index rows = src.rows();
+            const Index cols = src.cols();
+            for (Index j = 0; j < cols; j += COPY_TILE){
+                for (Index i = 0; i < rows; i += COPY_TILE){
+                    if (i + COPY_TILE <= rows && j + COPY_TILE <= cols){
+                        dst.template block<COPY_TILE, COPY_TILE>(i, j) = src.template block<COPY_TILE, COPY_TILE>(i, j).template cast<Scalar>();
+                    }
+                    else{
+                        Index r = std::min(COPY_TILE, rows - i);
+                        Index c = std::min(COPY_TILE, cols - j);
+                        dst.block(i, j, r, c) = src.block(i, j, r, c).template cast<Scalar>();
+                    }
+                }
+            }
+        }
+
+        // 列数をチャンクの倍数に切り上げて確保(サイズが変わったときだけ。余りの列は0)
+        template <typename Scalar>
+        Index resize_padded(Matrix<Scalar, Dynamic, Dynamic, RowMajor> &m, Index rows, Index cols)
+        {
+            const Index size = Chunk<Scalar>::size;
+            const Index padded = (cols + size - 1) / size * size;
+            if (m.rows() != rows || m.cols() != padded){
+                m.setZero(rows, padded);
+            }
+            return padded;
+        }
+    }
+
+    // C = X * W (X：CSR, W：密行列)
+    // X の非0要素 (i, c, v) ごとに「C の i 行目 += v × W の c 行目」を計算する。
+    // 行を連続に読めるように W を行優先にコピーし(W の型が異なる場合(bfloat16など)もここで変換する)、
+    // C の1行分(チャンク幅)をレジスタに置いたまま、その行の非0要素をすべて積和する。
+    // W_version に W の版(BasicParameterBuffer::version)を渡すと、前回と同じ W・同じ版ならコピーを省く(0 なら毎回コピー)。
+    template <typename Scalar, typename Rhs, typename Dst>
+    void sparse_gemm_noalloc(const SparseImageBatch<Scalar> &X, const Rhs &W, Dst &&C, BasicSparseGemmWorkspace<Scalar> &ws, uint64_t W_version = 0)
+    {
+        using namespace sparse_gemm_internal;
+        typedef typename Chunk<Scalar>::Type ChunkVector;
+        typedef typename Chunk<Scalar>::ConstMap ChunkMap;
+        const int T = Chunk<Scalar>::size;
+        eigen_assert(X.cols == W.rows() && X.rows == C.rows() && W.cols() == C.cols());
+
+        const Index N = W.cols();
+        const Index ld = resize_padded(ws.out_rows, X.rows, N); // W_rows と同じ幅
+        if (W_version == 0 || ws.W_version != W_version || ws.W_source != (const void *)W.data() ||
+            ws.W_rows.rows() != X.cols || ws.W_rows.cols() != ld){
+            resize_padded(ws.W_rows, X.cols, N);
+            copy_tiled(W, ws.W_rows.leftCols(N));
+            ws.W_source = W.data();
+            ws.W_version = W_version;
+        }
+
+        const int *col = X.col_idx.data();
+        const Scalar *val = X.values.data();
+        const Scalar *w = ws.W_rows.data();
+        for (int i = 0; i < X.rows; i++){
+            const int begin = X.row_ptr[i];
+            const int end = X.row_ptr[i + 1];
+            for (Index j = 0; j < ld; j += T){
+                // 積和の依存関係を分けるため、累積を2つに分ける
+                ChunkVector acc0 = ChunkVector::Zero();
+                ChunkVector acc1 = ChunkVector::Zero();
+                int k = begin;
+                for (; k + 2 <= end; k += 2){
+                    acc0 += val[k] * ChunkMap(w + col[k] * ld + j);
+                    acc1 += val[k + 1] * ChunkMap(w + col[k + 1] * ld + j);
+                }
+                if (k < end){
+                    acc0 += val[k] * ChunkMap(w + col[k] * ld + j);
+                }
+                ws.out_rows.template block<1, T>(i, j) = acc0 + acc1;
+            }
+        }
+        copy_tiled(ws.out_rows.leftCols(N), C);
+    }
+
+    // C = Xᵀ * D (X：CSR, D：密行列。1層目の重みの勾配 Xᵀ * da1 に使う)
+    // X を CSC 形式(画素ごとの非0要素)に並べ替え、画素 c ごとに「C の c 行目 = Σ v × D の i 行目」を
+    // レジスタ上で積和して1回だけ書き込む。どの入力にも現れない画素の行は0。
+    template <typename Scalar, typename Rhs, typename Dst>
+    void sparse_transpose_gemm_noalloc(const SparseImageBatch<Scalar> &X, const Rhs &D, Dst &&C, BasicSparseGemmWorkspace<Scalar> &ws)
+    {
+        using namespace sparse_gemm_internal;
+        typedef typename Chunk<Scalar>::Type ChunkVector;
+        typedef typename Chunk<Scalar>::ConstMap ChunkMap;
+        const int T = Chunk<Scalar>::size;
+        eigen_assert(X.rows == D.rows() && X.cols == C.rows() && D.cols() == C.cols());
+
+        const Index N = D.cols();
+        const Index ld = resize_padded(ws.D_rows, X.rows, N);
+        resize_padded(ws.dW_rows, X.cols, N);
+        copy_tiled(D, ws.D_rows.leftCols(N));
+
+        // CSR → CSC(画素ごとの個数を数えてから、行の順に詰める)
+        ws.col_ptr.assign(X.cols + 1, 0);
+        for (int k = 0; k < X.nnz(); k++){
+            ws.col_ptr[X.col_idx[k] + 1]++;
+        }
+        for (int c = 0; c < X.cols; c++){
+            ws.col_ptr[c + 1] += ws.col_ptr[c];
+        }
+        ws.col_next.assign(ws.col_ptr.begin(), ws.col_ptr.end() - 1);
+        ws.col_rows.resize(X.nnz());
+        ws.col_values.resize(X.nnz());
+        for (int i = 0; i < X.rows; i++){
+            for (int k = X.row_ptr[i]; k < X.row_ptr[i + 1]; k++){
+                int p = ws.col_next[X.col_idx[k]]++;
+                ws.col_rows[p] = i;
+                ws.col_values[p] = X.values[k];
+            }
+        }
+
+        const int *row = ws.col_rows.data();
+        const Scalar *val = ws.col_values.data();
+        const Scalar *d = ws.D_rows.data();
+        for (int c = 0; c < X.cols; c++){
+            const int begin = ws.col_ptr[c];
+            const int end = ws.col_ptr[c + 1];
+            if (begin == end){
+                ws.dW_rows.row(c).setZero();
+                continue;
+            }
+            for (Index j = 0; j < ld; j += T){
+                ChunkVector acc0 = ChunkVector::Zero();
+                ChunkVector acc1 = ChunkVector::Zero();
+                int p = begin;
+                for (; p + 2 <= end; p += 2){
+                    acc0 += val[p] * ChunkMap(d + row[p] * ld + j);
+                    acc1 += val[p + 1] * ChunkMap(d + row[p + 1] * ld + j);
+                }
+                if (p < end){
+                    acc0 += val[p] * ChunkMap(d + row[p] * ld + j);
+                }
+                ws.dW_rows.template block<1, T>(c, j) = acc0 + acc1;
+            }
+        }
+        copy_tiled(ws.dW_rows.leftCols(N), C);
+    }
+}
+
+#endif // _SPARSE_GEMM_H_
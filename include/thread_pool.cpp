@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+namespace MyDL{
+
+    ThreadPool::ThreadPool(int num_threads)
+    {
+        if (num_threads <= 0){
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (int i = 0; i < num_threads; i++){
+            _workers.emplace_back(&ThreadPool::_worker_loop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _start_cv.notify_all();
+
+        for (auto &worker : _workers){
+            worker.join();
+        }
+    }
+
+    void ThreadPool::parallel_for(int num_tasks, const std::function<void(int, int)> &task)
+    {
+        if (num_tasks <= 0){
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _task = &task;
+        _num_tasks = num_tasks;
+        _next_task = 0;
+        _running_workers = (int)_workers.size();
+        _generation++;
+        _start_cv.notify_all();
+
+        // 全ワーカーがタスクを取り尽くして戻ってくるまで待つ
+        _done_cv.wait(lock, [this] { return _running_workers == 0; });
+        _task = nullptr;
+    }
+
+    void ThreadPool::_worker_loop(int thread_id)
+    {
+        long seen_generation = 0;
+
+        while (true){
+            const std::function<void(int, int)> *task;
+            int num_tasks;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _start_cv.wait(lock, [&] { return _stop || _generation != seen_generation; });
+                if (_stop){
+                    return;
+                }
+                seen_generation = _generation;
+                task = _task;
+                num_tasks = _num_tasks;
+            }
+
+            // タスクはアトミックカウンタで動的に割り振る
+            for (int i = _next_task++; i < num_tasks; i = _next_task++){
+                (*task)(i, thread_id);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _running_workers--;
+            }
+            _done_cv.notify_one();
+        }
+    }
+
+}
@@ -0,0 +1,46 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace MyDL{
+
+    // ---------------------------------------------
+    //       固定スレッド数のシンプルなスレッドプール
+    // ---------------------------------------------
+    // parallel_for で渡したタスク(0 ~ num_tasks-1)を各スレッドが順に取り出して実行する。
+    // スレッドIDはスレッドごとのバッファ(部分和など)を持たせるために使う。
+    class ThreadPool{
+        private:
+            std::vector<std::thread> _workers;
+            std::mutex _mutex;
+            std::condition_variable _start_cv;
+            std::condition_variable _done_cv;
+
+            const std::function<void(int, int)> *_task = nullptr;
+            int _num_tasks = 0;
+            std::atomic<int> _next_task{0};
+            int _running_workers = 0;
+            long _generation = 0;  // parallel_for の呼び出し回数(起床判定用)
+            bool _stop = false;
+
+        private:
+            void _worker_loop(int);
+
+        public:
+            explicit ThreadPool(int num_threads = 0); // 0のときはハードウェアのスレッド数
+            ~ThreadPool();
+            ThreadPool(const ThreadPool &) = delete;
+            ThreadPool &operator=(const ThreadPool &) = delete;
+
+            int size(void) const { return (int)_workers.size(); }
+            void parallel_for(int, const std::function<void(int task_id, int thread_id)> &); // 全タスク完了まで待つ
+    };
+}
+
+#endif // _THREAD_POOL_H_
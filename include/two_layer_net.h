@@ -1,34 +1,179 @@
 #ifndef _TWO_LAYER_NET_H_
 #define _TWO_LAYER_NET_H_
 
-#include <map>
 #include <string>
+#include <type_traits>
 #include <Eigen/Dense>
+#include "parameter_buffer.h"
+#include "simple_activation.h"
+#include "sparse_gemm.h"
 
 namespace MyDL{
 
     using namespace Eigen;
     using std::string;
-    using std::map;
 
-    class TwoLayerNet{
+    template <typename Scalar>
+    class BasicOptimizer;
+
+    // 中間結果の行列型：サイズがコンパイル時に決まっていて EIGEN_STACK_ALLOCATION_LIMIT に収まるなら固定サイズ行列
+    // (ヒープ確保・サイズ判定なし)、それ以外は動的サイズ行列
+    template <typename Scalar, int Rows, int Cols>
+    struct ActivationMatrix{
+        static const bool is_fixed = Rows != Dynamic && Cols != Dynamic && (size_t)Rows * Cols * sizeof(Scalar) <= EIGEN_STACK_ALLOCATION_LIMIT;
+        typedef typename std::conditional<is_fixed, Matrix<Scalar, Rows, Cols>, Matrix<Scalar, Dynamic, Dynamic>>::type type;
+    };
+
+    // 順伝播・逆伝播の作業領域(バッチサイズが変わったときだけ確保し直す)
+    template <typename Scalar, int Batch = Dynamic, int Hidden = Dynamic, int Out = Dynamic>
+    struct BasicTwoLayerWorkspace{
+        typedef typename ActivationMatrix<Scalar, Batch, Hidden>::type HiddenMatrix;
+        typedef typename ActivationMatrix<Scalar, Batch, Out>::type OutputMatrix;
+
+        HiddenMatrix a1, z1;    // 順伝播の計算結果(逆伝播にも使う)
+        OutputMatrix a2, y;
+        OutputMatrix da2;       // 逆伝播の中間結果
+        HiddenMatrix dz1, da1;
+        BasicSparseGemmWorkspace<Scalar> sparse; // 入力が CSR 形式の場合のみ使う
+
+        void resize(Index batch_size, Index hidden_size, Index output_size);
+    };
+
+    typedef BasicTwoLayerWorkspace<double> TwoLayerWorkspace;
+
+    // 推論専用の作業領域(呼び出し側またはスレッドごとに持つ。バッチサイズは任意)
+    template <typename Scalar>
+    struct BasicInferenceWorkspace{
+        Matrix<Scalar, Dynamic, Dynamic> a1, a2, y;
+    };
+
+    // train_step の結果(更新前のパラメータでの順伝播から計算)
+    struct TrainStepResult{
+        double loss = 0;
+        double accuracy = 0;
+    };
+
+    // Scalar：パラメータの保持型(double / float / bfloat16)
+    // In, Hidden, Out, Batch：コンパイル時に固定する次元(Dynamic なら実行時に指定)
+    template <typename Scalar, int In = Dynamic, int Hidden = Dynamic, int Out = Dynamic, int Batch = Dynamic>
+    class BasicTwoLayerNet{
+        public:
+            typedef typename NetScalarTraits<Scalar>::Compute ComputeScalar;
+            typedef Matrix<ComputeScalar, Dynamic, Dynamic> ComputeMatrix;          // 入力・教師データの行列型
+            typedef BasicTwoLayerWorkspace<ComputeScalar, Batch, Hidden, Out> Workspace;
+            typedef typename Workspace::OutputMatrix OutputMatrix;                   // 出力(Batch × Out)の行列型
+            typedef BasicInferenceWorkspace<ComputeScalar> InferenceWorkspace;
+            typedef SparseImageBatch<ComputeScalar> SparseInput;                     // CSR 形式の入力
+
+            // params / grads 内のテンソルID
+            enum ParamId { W1 = 0, b1 = 1, W2 = 2, b2 = 3 };
+
         private:
             int _input_size;
             int _hidden_size;
             int _output_size;
             double _weight_init_std;
-            map<string, MatrixXd> _cache; // 逆伝播に使用するための計算結果キャッシュ
+            ActivationAccuracy _activation_accuracy = ActivationAccuracy::Exact; // 隠れ層sigmoidの計算精度
+            // CSR 入力の非0要素の割合がこれを超えるバッチは密な行列積で計算する
+            // (隠れ層100・バッチ100で測った学習1ステップの損益分岐点。推論は W1 の並べ替えを使い回せるので 0.3 付近まで疎が速い)
+            double _sparse_density_threshold = 0.2;
+
+            // 逆伝播に使用するための計算結果キャッシュ兼作業領域
+            Workspace _ws;
+
+        private:
+            // on_ready を指定しない場合の通知先(W1 の勾配も列ブロックに分けずに1回で計算する)
+            struct NoNotify{ void operator()(int, Index, Index) const {} };
+            static const Index W1_NOTIFY_COLS = 32; // on_ready を指定した場合に W1 の勾配を計算・通知する列数の単位
+
+        private:
+            void _init_params(void);
+            void _forward_logits(const Ref<const ComputeMatrix> &, Workspace &) const;
+            void _forward_logits(const SparseInput &, Workspace &) const;
+            void _forward_hidden(Workspace &) const; // ws.a1 = X * W1 が求まった後の残りの順伝播
+            template <typename Input, typename OnReady>
+            void _backward(const Input &, Workspace &, BasicParameterBuffer<ComputeScalar> &, OnReady &&) const;
+            template <typename Input>
+            void _backward(const Input &X, Workspace &ws, BasicParameterBuffer<ComputeScalar> &g) const { _backward(X, ws, g, NoNotify()); }
+            template <typename OnReady>
+            void _gradient_W1(const Ref<const ComputeMatrix> &, Workspace &, BasicParameterBuffer<ComputeScalar> &, OnReady &&) const; // Xᵀ * da1
+            template <typename OnReady>
+            void _gradient_W1(const SparseInput &, Workspace &, BasicParameterBuffer<ComputeScalar> &, OnReady &&) const;
+            template <typename Lhs, typename OnReady>
+            void _gradient_W1_dense(const Lhs &, Workspace &, BasicParameterBuffer<ComputeScalar> &, OnReady &&) const;
+            template <typename Input, typename OnReady>
+            TrainStepResult _forward_backward(const Input &, const Ref<const ComputeMatrix> &, Workspace &, BasicParameterBuffer<ComputeScalar> &, OnReady &&) const;
+            bool _use_dense(const SparseInput &X) const { return X.density() > _sparse_density_threshold; }
+            double _batch_accuracy(const OutputMatrix &, const Ref<const ComputeMatrix> &) const;
+            void _infer_logits(const Ref<const ComputeMatrix> &, InferenceWorkspace &) const;
+
+            // パラメータ・勾配の参照(固定次元なら固定サイズのMap)
+            Map<const Matrix<Scalar, In, Hidden>> _W1(void) const { return params.template matrix<In, Hidden>(W1); }
+            Map<const Matrix<Scalar, Hidden, Out>> _W2(void) const { return params.template matrix<Hidden, Out>(W2); }
+            Map<const Matrix<Scalar, Hidden, 1>> _b1(void) const { return params.template vec<Hidden>(b1); }
+            Map<const Matrix<Scalar, Out, 1>> _b2(void) const { return params.template vec<Out>(b2); }
 
         public:
-            map<string, MatrixXd> params; // MLPのパラメータ(最適化するときに取り出すのでpublic変数に)
+            BasicParameterBuffer<Scalar> params;        // MLPのパラメータ(最適化するときに取り出すのでpublic変数に)
+            BasicParameterBuffer<ComputeScalar> grads;  // 勾配(paramsと同じ配置 → params.flat() と grads.flat() で一括更新できる)
 
         public:
-            TwoLayerNet();                                          // デフォルトコンストラクタ
-            TwoLayerNet(int, int, int, double);                     // 引数付きコンストラクタ(入力層と隠れ層のunit数を指定)
-            MatrixXd predict(MatrixXd &);                           // 推論処理
-            double loss(MatrixXd &, MatrixXd &);                    // 損失関数
-            double accuracy(MatrixXd &, MatrixXd &);                // 精度
-            map<string, MatrixXd> gradient(MatrixXd &, MatrixXd &); // 勾配計算(計算グラフ → 誤差逆伝播法)
+            BasicTwoLayerNet();                                                  // デフォルトコンストラクタ(固定次元ならその次元)
+            explicit BasicTwoLayerNet(double);                                   // 固定次元用(重みの初期値の標準偏差のみ指定)
+            BasicTwoLayerNet(int, int, int, double);                             // 引数付きコンストラクタ(入力層と隠れ層のunit数を指定)
+            const OutputMatrix &predict(const Ref<const ComputeMatrix> &);                 // 推論処理
+            double loss(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &);     // 損失関数
+            double accuracy(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &); // 精度
+            const BasicParameterBuffer<ComputeScalar> &gradient(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &); // 勾配計算(計算グラフ → 誤差逆伝播法)
+            TrainStepResult train_step(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, double); // 順伝播・逆伝播・SGD更新を1回ずつ
+            TrainStepResult train_step(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, BasicOptimizer<Scalar> &); // 更新を optimizer で行う版
+            // 順伝播・逆伝播のみ(作業領域・勾配の出力先を指定。メンバは変更しないので複数スレッドから同時に呼べる)
+            TrainStepResult forward_backward(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, Workspace &, BasicParameterBuffer<ComputeScalar> &) const;
+            // 逆伝播の途中で、勾配が確定した範囲を on_ready(テンソルID, begin, end) に通知する版(W2, b2, W1, b1 の順)
+            // begin, end は g.data() からの位置。W1 は密行列の入力なら W1_NOTIFY_COLS 列ずつ計算して複数回に分けて通知する
+            // (後ろの層・先に計算した列の勾配の通信を、残りの逆伝播と重ねるときに使う)
+            template <typename OnReady>
+            TrainStepResult forward_backward(const Ref<const ComputeMatrix> &, const Ref<const ComputeMatrix> &, Workspace &, BasicParameterBuffer<ComputeScalar> &, OnReady &&) const;
+
+            // 入力が CSR 形式の版(MnistEigenDataset::next_train に SparseImageBatch を渡して読み出したバッチなど)
+            // 1層目の X * W1 と Xᵀ * da1 は非0の画素だけで計算する。
+            // 非0要素の割合が sparse_density_threshold を超えるバッチは、密行列に展開して通常の行列積で計算する。
+            const OutputMatrix &predict(const SparseInput &);
+            const BasicParameterBuffer<ComputeScalar> &gradient(const SparseInput &, const Ref<const ComputeMatrix> &);
+            TrainStepResult train_step(const SparseInput &, const Ref<const ComputeMatrix> &, double);
+            TrainStepResult train_step(const SparseInput &, const Ref<const ComputeMatrix> &, BasicOptimizer<Scalar> &);
+
+            // 推論専用(const)：params は読むだけで、書き込むのは作業領域 ws(省略時はスレッドローカル)のみなので、
+            // 1つのモデルを複数スレッドから同時に使える(学習の更新とは同時に呼ばないこと)
+            const Matrix<ComputeScalar, Dynamic, Dynamic> &infer(const Ref<const ComputeMatrix> &, InferenceWorkspace &) const; // softmaxの出力
+            const Matrix<ComputeScalar, Dynamic, Dynamic> &infer(const Ref<const ComputeMatrix> &) const;
+            void infer_argmax(const Ref<const ComputeMatrix> &, Ref<VectorXi>, InferenceWorkspace &) const; // 予測ラベルのみ(softmaxを省略)
+            void infer_argmax(const Ref<const ComputeMatrix> &, Ref<VectorXi>) const;
+
+            void set_activation_accuracy(ActivationAccuracy accuracy) { _activation_accuracy = accuracy; }
+            ActivationAccuracy activation_accuracy(void) const { return _activation_accuracy; }
+            void set_sparse_density_threshold(double threshold) { _sparse_density_threshold = threshold; }
+            double sparse_density_threshold(void) const { return _sparse_density_threshold; }
     };
+
+    typedef BasicTwoLayerNet<double> TwoLayerNet;       // 従来どおりのdouble版
+    typedef BasicTwoLayerNet<float> TwoLayerNetF;       // float版(行列積のスループットが約2倍)
+    typedef BasicTwoLayerNet<bfloat16> TwoLayerNetBF16; // 重みをbfloat16で保持(計算はfloat)
+
+    // 次元をコンパイル時に固定した版(例：FixedTwoLayerNet<784, 100, 10, 100>)
+    // 出力層などの小さな行列は固定サイズになり、ループ展開・サイズ判定の省略・スタック配置が効く。
+    // バッチサイズも固定なので、Batch 行以外の入力は渡せない。
+    template <int In, int Hidden, int Out, int Batch, typename Scalar = double>
+    using FixedTwoLayerNet = BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>;
+
+    extern template struct BasicTwoLayerWorkspace<double>;
+    extern template struct BasicTwoLayerWorkspace<float>;
+    extern template class BasicTwoLayerNet<double>;
+    extern template class BasicTwoLayerNet<float>;
+    extern template class BasicTwoLayerNet<bfloat16>;
 }
-#endif // _TWO_LAYER_NET_H_
\ No newline at end of file
+
+// 実装(固定次元の版は使用側でインスタンス化する)
+#include "two_layer_net_impl.h"
+
+#endif // _TWO_LAYER_NET_H_
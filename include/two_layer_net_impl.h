@@ -0,0 +1,366 @@
+#ifndef _TWO_LAYER_NET_IMPL_H_
+#define _TWO_LAYER_NET_IMPL_H_
+
+// BasicTwoLayerNet の実装(two_layer_net.h から読み込まれる)
+// double / float / bfloat16 の動的次元版は two_layer_net.cpp で明示的にインスタンス化している
+
+#include <Eigen/Dense>
+#include "two_layer_net.h"
+#include "gemm.h"
+#include "simple_activation.h"
+#include "simple_loss.h"
+#include "optimizer.h"
+
+namespace MyDL
+{
+
+    using namespace Eigen;
+
+    template <typename Scalar, int Batch, int Hidden, int Out>
+    void BasicTwoLayerWorkspace<Scalar, Batch, Hidden, Out>::resize(Index batch_size, Index hidden_size, Index output_size)
+    {
+        if (a1.rows() == batch_size && a1.cols() == hidden_size && y.cols() == output_size){
+            return;
+        }
+
+        a1.resize(batch_size, hidden_size);
+        z1.resize(batch_size, hidden_size);
+        dz1.resize(batch_size, hidden_size);
+        da1.resize(batch_size, hidden_size);
+        a2.resize(batch_size, output_size);
+        y.resize(batch_size, output_size);
+        da2.resize(batch_size, output_size);
+    }
+
+    // デフォルトコンストラクタ(初期値は適当。固定次元ならその次元)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::BasicTwoLayerNet() : BasicTwoLayerNet(In == Dynamic ? 3 : In, Hidden == Dynamic ? 3 : Hidden, Out == Dynamic ? 2 : Out, 0.01)
+    {
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::BasicTwoLayerNet(double weight_init_std) : BasicTwoLayerNet(In == Dynamic ? 3 : In, Hidden == Dynamic ? 3 : Hidden, Out == Dynamic ? 2 : Out, weight_init_std)
+    {
+    }
+
+    // 初期値ありのコンストラクタ
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::BasicTwoLayerNet(int input_size, int hidden_size, int output_size, double weight_init_std) : _input_size(input_size), _hidden_size(hidden_size), _output_size(output_size), _weight_init_std(weight_init_std)
+    {
+        eigen_assert((In == Dynamic || In == input_size) && (Hidden == Dynamic || Hidden == hidden_size) && (Out == Dynamic || Out == output_size));
+        _init_params();
+    }
+
+    // paramsに格納する変数の初期化(gradsも同じ配置で確保)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_init_params(void)
+    {
+        params.add("W1", _input_size, _hidden_size);
+        params.add("b1", _hidden_size, 1);
+        params.add("W2", _hidden_size, _output_size);
+        params.add("b2", _output_size, 1);
+        for (int i = 0; i < params.count(); i++){
+            grads.add(params.name(i), params.matrix(i).rows(), params.matrix(i).cols());
+        }
+
+        // 標準偏差0(保存したモデルを読み込む場合など)は0のまま
+        if (_weight_init_std != 0){
+            params.matrix(W1) = (_weight_init_std * ComputeMatrix::Random(_input_size, _hidden_size)).template cast<Scalar>();
+            params.matrix(W2) = (_weight_init_std * ComputeMatrix::Random(_hidden_size, _output_size)).template cast<Scalar>();
+        }
+    }
+
+    // 作業領域はバッチサイズが変わったときだけ確保し直し、行列積は gemm_noalloc を使うので、
+    // 同じバッチサイズが続く限りメモリ確保は発生しない
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    const typename BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::OutputMatrix &BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::predict(const Ref<const ComputeMatrix> &X)
+    {
+        _forward_logits(X, _ws);
+        softmax(_ws.a2, _ws.y);
+
+        return _ws.y;
+    }
+
+    // CSR 形式の入力の推論
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    const typename BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::OutputMatrix &BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::predict(const SparseInput &X)
+    {
+        _forward_logits(X, _ws);
+        softmax(_ws.a2, _ws.y);
+
+        return _ws.y;
+    }
+
+    // softmax の手前(a2)までの順伝播
+    // bfloat16 の重みは gemm_noalloc がタイル単位でfloatに変換して使う
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_forward_logits(const Ref<const ComputeMatrix> &X, Workspace &ws) const
+    {
+        ws.resize(X.rows(), _hidden_size, _output_size);
+        gemm_noalloc(X, _W1(), ws.a1);
+        _forward_hidden(ws);
+    }
+
+    // 入力が CSR 形式の場合：1層目の行列積だけを非0要素で計算する(密なバッチは展開して通常の行列積)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_forward_logits(const SparseInput &X, Workspace &ws) const
+    {
+        ws.resize(X.rows, _hidden_size, _output_size);
+        if (_use_dense(X)){
+            X.to_dense(ws.sparse.X_dense); // 逆伝播でも使う
+            gemm_noalloc(ws.sparse.X_dense, _W1(), ws.a1);
+        }
+        else{
+            sparse_gemm_noalloc(X, _W1(), ws.a1, ws.sparse, params.version()); // 前回から params が書き換えられていなければ W1 の並べ替えを省く
+        }
+        _forward_hidden(ws);
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_forward_hidden(Workspace &ws) const
+    {
+        // ブロードキャスト演算をするように実装(numpyとは仕様が違うことに注意)
+        ws.a1.rowwise() += _b1().transpose().template cast<ComputeScalar>();
+        sigmoid(ws.a1, ws.z1, _activation_accuracy);
+        gemm_noalloc(ws.z1, _W2(), ws.a2);
+        ws.a2.rowwise() += _b2().transpose().template cast<ComputeScalar>();
+    }
+
+    // 推論専用の順伝播(softmax の手前まで)：結果は ws に書き込み、メンバは変更しない
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_infer_logits(const Ref<const ComputeMatrix> &X, InferenceWorkspace &ws) const
+    {
+        ws.a1.resize(X.rows(), _hidden_size);
+        ws.a2.resize(X.rows(), _output_size);
+
+        gemm_noalloc(X, _W1(), ws.a1);
+        ws.a1.rowwise() += _b1().transpose().template cast<ComputeScalar>();
+        sigmoid(ws.a1, ws.a1, _activation_accuracy);
+        gemm_noalloc(ws.a1, _W2(), ws.a2);
+        ws.a2.rowwise() += _b2().transpose().template cast<ComputeScalar>();
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    const Matrix<typename BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::ComputeScalar, Dynamic, Dynamic> &
+    BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::infer(const Ref<const ComputeMatrix> &X, InferenceWorkspace &ws) const
+    {
+        _infer_logits(X, ws);
+        ws.y.resize(ws.a2.rows(), ws.a2.cols());
+        softmax(ws.a2, ws.y);
+
+        return ws.y;
+    }
+
+    // 作業領域はスレッドごとに1つ(戻り値は同じスレッドで次に infer を呼ぶまで有効)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    const Matrix<typename BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::ComputeScalar, Dynamic, Dynamic> &
+    BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::infer(const Ref<const ComputeMatrix> &X) const
+    {
+        static thread_local InferenceWorkspace ws;
+        return infer(X, ws);
+    }
+
+    // argmax は logits 上で取れば softmax と同じ結果になるので、正規化は行わない
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::infer_argmax(const Ref<const ComputeMatrix> &X, Ref<VectorXi> labels, InferenceWorkspace &ws) const
+    {
+        _infer_logits(X, ws);
+        for (Index i = 0; i < ws.a2.rows(); i++){
+            Index label;
+            ws.a2.row(i).maxCoeff(&label);
+            labels(i) = (int)label;
+        }
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::infer_argmax(const Ref<const ComputeMatrix> &X, Ref<VectorXi> labels) const
+    {
+        static thread_local InferenceWorkspace ws;
+        infer_argmax(X, labels, ws);
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    double BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::loss(const Ref<const ComputeMatrix> &x, const Ref<const ComputeMatrix> &t)
+    {
+        _forward_logits(x, _ws);
+        return softmax_cross_entropy(_ws.a2, t, _ws.y, _ws.da2);
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    double BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::accuracy(const Ref<const ComputeMatrix>& x, const Ref<const ComputeMatrix>& t){
+        const OutputMatrix &y = this->predict(x);
+        return _batch_accuracy(y, t);
+    }
+
+    // 各行ごとに、最大要素のインデックスを取得 → インデックスが等しければ、accuracyに加算
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    double BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_batch_accuracy(const OutputMatrix& y, const Ref<const ComputeMatrix>& t) const{
+        Index y_row, y_col, t_row, t_col;
+
+        double accuracy = 0;
+        int batch_size = t.rows();
+
+        for (int i=0; i < batch_size; i++){
+            y.row(i).maxCoeff(&y_row, &y_col);
+            t.row(i).maxCoeff(&t_row, &t_col);
+
+            accuracy += (double)(y_col == t_col); // カラムのインデックスだけ見ればOK
+        }
+
+        return accuracy / batch_size;
+    }
+
+    // 数値微分では遅すぎるので、誤差逆伝播法を実装
+    // 勾配は grads(paramsと同じ配置の連続領域)に書き込み、その参照を返す
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    const BasicParameterBuffer<typename BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::ComputeScalar> &BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::gradient(const Ref<const ComputeMatrix>& X, const Ref<const ComputeMatrix>& t){
+        // softmax with loss layer までの順伝播・逆伝播(_wsのキャッシュもここで保存される)
+        _forward_logits(X, _ws);
+        softmax_cross_entropy(_ws.a2, t, _ws.y, _ws.da2);
+        _backward(X, _ws, grads);
+
+        return grads;
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    const BasicParameterBuffer<typename BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::ComputeScalar> &BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::gradient(const SparseInput& X, const Ref<const ComputeMatrix>& t){
+        _forward_logits(X, _ws);
+        softmax_cross_entropy(_ws.a2, t, _ws.y, _ws.da2);
+        _backward(X, _ws, grads);
+
+        return grads;
+    }
+
+    // 1step分の学習：順伝播1回の結果から損失・精度を計算し、逆伝播 → パラメータ更新まで行う
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::train_step(const Ref<const ComputeMatrix>& X, const Ref<const ComputeMatrix>& t, double learning_rate){
+        TrainStepResult result = _forward_backward(X, t, _ws, grads, NoNotify());
+        // 全パラメータが連続領域にあるので1パスで更新(bfloat16はfloatで計算してから丸める)
+        params.flat() = (params.flat().template cast<ComputeScalar>() - (ComputeScalar)learning_rate * grads.flat()).template cast<Scalar>();
+
+        return result;
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::train_step(const SparseInput& X, const Ref<const ComputeMatrix>& t, double learning_rate){
+        TrainStepResult result = _forward_backward(X, t, _ws, grads, NoNotify());
+        params.flat() = (params.flat().template cast<ComputeScalar>() - (ComputeScalar)learning_rate * grads.flat()).template cast<Scalar>();
+
+        return result;
+    }
+
+    // 更新を optimizer(Momentum, Adam など)で行う版
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::train_step(const Ref<const ComputeMatrix>& X, const Ref<const ComputeMatrix>& t, BasicOptimizer<Scalar> &optimizer){
+        TrainStepResult result = _forward_backward(X, t, _ws, grads, NoNotify());
+        optimizer.update(params, grads);
+
+        return result;
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::train_step(const SparseInput& X, const Ref<const ComputeMatrix>& t, BasicOptimizer<Scalar> &optimizer){
+        TrainStepResult result = _forward_backward(X, t, _ws, grads, NoNotify());
+        optimizer.update(params, grads);
+
+        return result;
+    }
+
+    // 作業領域と勾配の出力先を指定する版(const：データ並列学習で各スレッドがバッチの一部を担当するときに使う)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::forward_backward(const Ref<const ComputeMatrix>& X, const Ref<const ComputeMatrix>& t,
+                                                                                       Workspace &ws, BasicParameterBuffer<ComputeScalar> &g) const{
+        return _forward_backward(X, t, ws, g, NoNotify());
+    }
+
+    // 勾配が確定したテンソルを通知する版
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    template <typename OnReady>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::forward_backward(const Ref<const ComputeMatrix>& X, const Ref<const ComputeMatrix>& t,
+                                                                                       Workspace &ws, BasicParameterBuffer<ComputeScalar> &g, OnReady &&on_ready) const{
+        return _forward_backward(X, t, ws, g, on_ready);
+    }
+
+    // 順伝播1回の結果から損失・精度を計算し、逆伝播まで行う(入力は密行列 / CSR 形式)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    template <typename Input, typename OnReady>
+    TrainStepResult BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_forward_backward(const Input& X, const Ref<const ComputeMatrix>& t,
+                                                                                        Workspace &ws, BasicParameterBuffer<ComputeScalar> &g, OnReady &&on_ready) const{
+        TrainStepResult result;
+
+        _forward_logits(X, ws);
+        result.loss = softmax_cross_entropy(ws.a2, t, ws.y, ws.da2);
+        result.accuracy = _batch_accuracy(ws.y, t);
+        _backward(X, ws, g, on_ready);
+
+        return result;
+    }
+
+    // 逆伝播計算(wsに保存された順伝播の結果と、softmax_cross_entropy で求めた da2 を使う)
+    // 勾配を書き終えた範囲ごとに on_ready(テンソルID, begin, end) を呼ぶ
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    template <typename Input, typename OnReady>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_backward(const Input& X, Workspace &ws, BasicParameterBuffer<ComputeScalar> &g, OnReady &&on_ready) const{
+        auto notify = [&](int id){
+            const Index begin = g.vec(id).data() - g.data();
+            on_ready(id, begin, begin + g.vec(id).size());
+        };
+        // affine layer 2
+        gemm_noalloc(ws.da2, _W2().transpose(), ws.dz1);
+        gemm_noalloc(ws.z1.transpose(), ws.da2, g.template matrix<Hidden, Out>(W2)); // 縦ベクトル × 横ベクトル の構図(バッチ方向に縮約)
+        notify((int)W2);
+        g.template vec<Out>(b2) = ws.da2.colwise().sum().transpose();
+        notify((int)b2);
+        // sigmoid layer: da1 = z1(1-z1) * dz1
+        ws.da1 = ws.z1.array() * (1 - ws.z1.array()) * ws.dz1.array();
+        // affine layer 1(W1 の通知は _gradient_W1 の中で行う)
+        _gradient_W1(X, ws, g, on_ready);
+        g.template vec<Hidden>(b1) = ws.da1.colwise().sum().transpose();
+        notify((int)b1);
+        // dx = da1 * W2.transpose() // → 今回は必要ないのでスルー
+    }
+
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    template <typename OnReady>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_gradient_W1(const Ref<const ComputeMatrix>& X, Workspace &ws, BasicParameterBuffer<ComputeScalar> &g, OnReady &&on_ready) const{
+        _gradient_W1_dense(X, ws, g, on_ready);
+    }
+
+    // 順伝播と同じ判定で、密行列に展開したバッチ(ws.sparse.X_dense)か非0要素だけを使う
+    // (非0要素だけで計算する場合は CSC への並べ替えが列ブロックごとに重複するので、全体を1回で計算して通知する)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    template <typename OnReady>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_gradient_W1(const SparseInput& X, Workspace &ws, BasicParameterBuffer<ComputeScalar> &g, OnReady &&on_ready) const{
+        if (_use_dense(X)){
+            _gradient_W1_dense(ws.sparse.X_dense, ws, g, on_ready);
+        }
+        else{
+            sparse_transpose_gemm_noalloc(X, ws.da1, g.template matrix<In, Hidden>(W1), ws.sparse);
+            const Index begin = g.vec(W1).data() - g.data();
+            on_ready((int)W1, begin, begin + g.vec(W1).size());
+        }
+    }
+
+    // dW1 = Xᵀ * da1(X は密行列)
+    // on_ready を指定した場合は W1_NOTIFY_COLS 列ずつ計算して、書き終えた列ブロックから通知する
+    // (列優先なので、列のブロックは g 上の連続した範囲になる)
+    template <typename Scalar, int In, int Hidden, int Out, int Batch>
+    template <typename Lhs, typename OnReady>
+    void BasicTwoLayerNet<Scalar, In, Hidden, Out, Batch>::_gradient_W1_dense(const Lhs& X, Workspace &ws, BasicParameterBuffer<ComputeScalar> &g, OnReady &&on_ready) const{
+        auto dW1 = g.template matrix<In, Hidden>(W1);
+        if constexpr (std::is_same<typename std::decay<OnReady>::type, NoNotify>::value){
+            gemm_noalloc(X.transpose(), ws.da1, dW1);
+        }
+        else{
+            const Index offset = dW1.data() - g.data();
+            for (Index j = 0; j < dW1.cols(); j += W1_NOTIFY_COLS){
+                const Index cols = std::min(dW1.cols() - j, (Index)W1_NOTIFY_COLS);
+                gemm_noalloc(X.transpose(), ws.da1.middleCols(j, cols), dW1.middleCols(j, cols));
+                on_ready((int)W1, offset + j * dW1.rows(), offset + (j + cols) * dW1.rows());
+            }
+        }
+    }
+
+}
+
+#endif // _TWO_LAYER_NET_IMPL_H_
@@ -0,0 +1,74 @@
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/simple_activation.h"
+
+using namespace Eigen;
+
+// 活性化関数の近似カーネルについて、精度ごとの誤差(標準ライブラリとの比較)とスループットを表示する
+int main()
+{
+    using std::cout;
+    using std::endl;
+    using std::string;
+    using std::vector;
+    using namespace MyDL;
+
+    const int rows = 1000;
+    const int cols = 1000;
+    const int repeat = 20;
+
+    // 評価範囲：学習中に現れる値を十分に含む [-20, 20]
+    MatrixXd x = 20 * MatrixXd::Random(rows, cols);
+    MatrixXd y(rows, cols);
+
+    vector<string> level_names = {"exact", "high", "fast"};
+    vector<ActivationAccuracy> levels = {ActivationAccuracy::Exact, ActivationAccuracy::High, ActivationAccuracy::Fast};
+    vector<string> func_names = {"exp", "sigmoid", "tanh"};
+
+    cout << "kernel ISA: " << activation_kernel_isa() << endl;
+
+    for (int f = 0; f < 3; f++){
+        // 基準値(スカラーの標準ライブラリ)
+        MatrixXd ref = x.unaryExpr([f](double p){
+            return f == 0 ? std::exp(p) : f == 1 ? 1 / (1 + std::exp(-p)) : std::tanh(p);
+        });
+
+        for (int l = 0; l < 3; l++){
+            auto run = [&](){
+                if (f == 0) exp_function(x, y, levels[l]);
+                else if (f == 1) sigmoid(x, y, levels[l]);
+                else tanh_function(x, y, levels[l]);
+            };
+
+            run();
+            double max_abs_err = (y - ref).cwiseAbs().maxCoeff();
+            double max_rel_err = ((y - ref).array() / ref.array().abs().max(1e-300)).abs().maxCoeff();
+
+            auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < repeat; r++){
+                run();
+            }
+            auto end = std::chrono::steady_clock::now();
+            double sec = std::chrono::duration<double>(end - start).count();
+
+            cout << func_names[f] << " [" << level_names[l] << "]"
+                 << " max abs err: " << max_abs_err
+                 << " max rel err: " << max_rel_err
+                 << " throughput: " << (double)rows * cols * repeat / sec / 1e6 << " Melem/s" << endl;
+        }
+    }
+
+    // 参考：ReLU
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++){
+        relu(x, y);
+    }
+    auto end = std::chrono::steady_clock::now();
+    cout << "relu throughput: " << (double)rows * cols * repeat / std::chrono::duration<double>(end - start).count() / 1e6 << " Melem/s" << endl;
+
+    return 0;
+}
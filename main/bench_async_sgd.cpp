@@ -0,0 +1,91 @@
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/evaluator.h"
+#include "../include/hogwild_trainer.h"
+#include "../include/data_parallel_trainer.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 非同期SGD(Hogwild)と同期データ並列の、目標精度に達するまでの時間をスレッド数ごとに比較する
+//   使い方：bench_async_sgd [目標精度(既定0.9)] [スレッドあたりのバッチサイズ(既定10)]
+// どちらも1ラウンドで各スレッドが steps_per_round 回更新(同期版はバッチ = スレッド数 × バッチサイズ)し、
+// ラウンドごとにテストデータ全件で評価する(評価時間は含めない)。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using std::vector;
+    using namespace MyDL;
+
+    double target_accuracy = argc > 1 ? std::atof(argv[1]) : 0.9;
+    int batch_size = argc > 2 ? std::atoi(argv[2]) : 10;
+    const int steps_per_round = 20;
+    const int max_rounds = 500;
+    const double learning_rate = 0.1;
+
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    MnistEigenDataset eval_dataset(batch_size);
+    Evaluator evaluator;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2){
+        // Hogwild：スレッドごとに別シードのデータローダ
+        {
+            TwoLayerNet net(28 * 28, 100, 10, 0.01);
+            vector<std::unique_ptr<MnistEigenDataset>> datasets;
+            vector<MnistEigenDataset *> cursors;
+            for (int i = 0; i < threads; i++){
+                datasets.emplace_back(new MnistEigenDataset(batch_size, true, 1000 + i));
+                cursors.push_back(datasets.back().get());
+            }
+            HogwildTrainer trainer(net, cursors);
+
+            double seconds = 0;
+            double staleness = 0;
+            int round = 0;
+            double accuracy = 0;
+            while (round < max_rounds && accuracy < target_accuracy){
+                HogwildStats stats = trainer.run(steps_per_round, learning_rate);
+                seconds += stats.seconds;
+                staleness += stats.mean_staleness;
+                round++;
+                accuracy = evaluator.evaluate_test(net, eval_dataset).accuracy();
+            }
+            cout << "hogwild  threads=" << threads << " time-to-accuracy: " << seconds << " s (" << round * steps_per_round * threads
+                 << " updates, accuracy " << accuracy << ", mean staleness " << staleness / round << ")" << endl;
+        }
+
+        // 同期データ並列：バッチ = スレッド数 × バッチサイズ
+        {
+            TwoLayerNet net(28 * 28, 100, 10, 0.01);
+            MnistEigenDataset dataset(batch_size * threads, true, 1000);
+            DataParallelTrainer trainer(net, threads, threads);
+            MatrixXd X = MatrixXd::Zero(batch_size * threads, 28 * 28);
+            MatrixXd t = MatrixXd::Zero(batch_size * threads, 10);
+
+            double seconds = 0;
+            int round = 0;
+            double accuracy = 0;
+            while (round < max_rounds && accuracy < target_accuracy){
+                auto start = std::chrono::steady_clock::now();
+                for (int step = 0; step < steps_per_round; step++){
+                    dataset.next_train(X, t, true);
+                    trainer.train_step(X, t, learning_rate);
+                }
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                round++;
+                accuracy = evaluator.evaluate_test(net, eval_dataset).accuracy();
+            }
+            cout << "sync     threads=" << threads << " time-to-accuracy: " << seconds << " s (" << round * steps_per_round
+                 << " steps, accuracy " << accuracy << ")" << endl;
+        }
+    }
+
+    return 0;
+}
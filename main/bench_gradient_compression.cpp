@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/evaluator.h"
+#include "../include/ring_allreduce.h"
+#include "../include/multi_process_trainer.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 勾配交換の圧縮方式(なし / top-k + 誤差フィードバック / 8bit確率的量子化)ごとに、
+// 1ステップあたりの送信バイト数と目標精度に達するまでの時間を比較する
+//   使い方：bench_gradient_compression [プロセス数(既定4)] [目標精度(既定0.9)] [top-kの割合(既定0.01)]
+// eval_interval ステップごとに rank 0 がテストデータ全件で評価する(評価時間は含めない)。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+
+    int num_procs = argc > 1 ? std::atoi(argv[1]) : 4;
+    double target_accuracy = argc > 2 ? std::atof(argv[2]) : 0.9;
+    double topk_ratio = argc > 3 ? std::atof(argv[3]) : 0.01;
+    const int batch_size = 100;
+    const double learning_rate = 0.1;
+    const int eval_interval = 50;
+    const int max_steps = 20000;
+
+    const char *names[] = {"dense", "top-k", "int8"};
+    CompressionType types[] = {CompressionType::None, CompressionType::TopK, CompressionType::Int8};
+
+    for (int c = 0; c < 3; c++){
+        bool ok = launch_ring_processes(num_procs, [&](RingAllReduce &ring){
+            MnistEigenDataset mnist(batch_size, true, 1000 + ring.rank());
+            MatrixXd train_X = MatrixXd::Zero(batch_size, 28 * 28);
+            MatrixXd train_y = MatrixXd::Zero(batch_size, 10);
+
+            TwoLayerNet net(28 * 28, 100, 10, 0.01);
+            MultiProcessTrainer trainer(net, ring);
+            CompressionConfig config;
+            config.type = types[c];
+            config.topk_ratio = topk_ratio;
+            trainer.set_compression(config);
+            Evaluator evaluator;
+
+            size_t bytes_start = ring.bytes_sent();
+            double seconds = 0;
+            double accuracy = 0;
+            int step = 0;
+            while (step < max_steps){
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < eval_interval; i++, step++){
+                    mnist.next_train(train_X, train_y, true);
+                    trainer.train_step(train_X, train_y, learning_rate);
+                }
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                // rank 0 の評価結果で全プロセスが終了を判断する
+                double done = 0;
+                if (ring.rank() == 0){
+                    accuracy = evaluator.evaluate_test(net, mnist).accuracy();
+                    done = accuracy >= target_accuracy ? 1 : 0;
+                }
+                ring.allreduce(&done, 1);
+                if (done > 0){
+                    break;
+                }
+            }
+            if (!trainer.ok()){
+                return 1;
+            }
+
+            if (ring.rank() == 0){
+                double bytes_per_step = (double)(ring.bytes_sent() - bytes_start) / step;
+                cout << names[c] << ": " << bytes_per_step / 1024 << " KiB sent/step/process, time-to-accuracy: " << seconds << " s ("
+                     << step << " steps, accuracy " << accuracy << ")" << endl;
+            }
+            return 0;
+        });
+        if (!ok){
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/inference_server.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 推論サーバのバッチング待ち時間(max_latency_us)ごとに、レイテンシ(p50/p99)とスループットを比較する
+//   使い方：bench_inference_server [クライアントのスレッド数(既定8)] [1スレッドあたりのリクエスト数(既定2000)]
+// 各クライアントは1枚ずつ送って結果を待ち、すぐ次を送る(同時に処理待ちになるのは最大でスレッド数の件数)。
+// 最後にUnixドメインソケット経由でも同じ計測を行う。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+
+    int num_clients = argc > 1 ? std::atoi(argv[1]) : 8;
+    int num_requests = argc > 2 ? std::atoi(argv[2]) : 2000;
+
+    // 学習(float)
+    MnistEigenDataset mnist(100);
+    TwoLayerNetF net(28 * 28, 100, 10, 0.01);
+    MatrixXf X = MatrixXf::Zero(100, 28 * 28);
+    MatrixXf t = MatrixXf::Zero(100, 10);
+    for (int i = 0; i < 1000; i++){
+        mnist.next_train(X, t, true);
+        net.train_step(X, t, 0.1);
+    }
+
+    Map<const ImageMatrixXu8> images = mnist.test_images_raw();
+    Map<const LabelVectorXi> labels = mnist.test_labels();
+    const int num_images = (int)labels.size();
+
+    // 1枚ずつ直接推論した場合の結果(サーバの結果と一致するか確認する)
+    VectorXi expected(num_images);
+    {
+        MatrixXf images_f = images.cast<float>() / 255.0f;
+        net.infer_argmax(images_f, expected);
+    }
+
+    auto report = [&](const char *name, const InferenceServerStats &stats, long mismatches){
+        cout << name << ": " << stats.requests << " requests, mean batch " << stats.mean_batch_size
+             << ", p50 " << stats.p50_us << " us, p99 " << stats.p99_us << " us, "
+             << stats.throughput << " requests/s, mismatches " << mismatches << endl;
+    };
+
+    // スレッド内：num_requests 回 classify(i) を呼び、期待値と異なった回数を返す
+    auto run_clients = [&](const std::function<bool(int, int, int &)> &classify){
+        std::vector<std::thread> clients;
+        std::vector<long> mismatches(num_clients, 0);
+        for (int c = 0; c < num_clients; c++){
+            clients.emplace_back([&, c]{
+                for (int r = 0; r < num_requests; r++){
+                    int i = (c * num_requests + r) % num_images;
+                    int label = -1;
+                    if (!classify(c, i, label) || label != expected(i)){
+                        mismatches[c]++;
+                    }
+                }
+            });
+        }
+        long total = 0;
+        for (int c = 0; c < num_clients; c++){
+            clients[c].join();
+            total += mismatches[c];
+        }
+        return total;
+    };
+
+    cout << num_clients << " clients x " << num_requests << " requests" << endl;
+    for (double max_latency_us : {0.0, 50.0, 200.0, 1000.0}){
+        InferenceServerConfig config;
+        config.max_batch_size = 64;
+        config.max_latency_us = max_latency_us;
+        InferenceServerF server(net, config);
+
+        long mismatches = run_clients([&](int, int i, int &label){
+            label = server.submit(images.row(i).data()).get().label;
+            return true;
+        });
+        string name = "in-process, window " + std::to_string((int)max_latency_us) + " us";
+        report(name.c_str(), server.stats(), mismatches);
+    }
+
+    // Unixドメインソケット経由
+    {
+        string path = "/tmp/bench_inference_server." + std::to_string(getpid()) + ".sock";
+        InferenceServerF server(net);
+        if (!server.listen(path)){
+            cout << "failed to listen: " << path << endl;
+            return 1;
+        }
+        std::vector<std::unique_ptr<InferenceClient>> connections;
+        for (int c = 0; c < num_clients; c++){
+            connections.emplace_back(new InferenceClient(28 * 28, 10));
+            if (!connections.back()->connect(path)){
+                cout << "failed to connect: " << path << endl;
+                return 1;
+            }
+        }
+        server.reset_stats();
+        long mismatches = run_clients([&](int c, int i, int &label){
+            return connections[c]->classify(images.row(i).data(), label);
+        });
+        string name = "unix socket, window " + std::to_string((int)server.config().max_latency_us) + " us";
+        report(name.c_str(), server.stats(), mismatches);
+    }
+
+    return 0;
+}
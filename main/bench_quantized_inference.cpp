@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/quantized_net.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// float推論とint8量子化推論の、テストデータ全件での精度とスループットを比較する
+//   使い方：bench_quantized_inference [学習ステップ数(既定2000)] [推論のバッチサイズ(既定100)]
+// float版は正規化済みの画像(test_images)、int8版は生の画素値(test_images_raw)をそのまま入力にする。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+
+    int num_iters = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int batch_size = argc > 2 ? std::atoi(argv[2]) : 100;
+    const int repeats = 5;
+
+    // 学習(float)
+    MnistEigenDataset mnist(100);
+    TwoLayerNetF net(28 * 28, 100, 10, 0.01);
+    MatrixXf X = MatrixXf::Zero(100, 28 * 28);
+    MatrixXf t = MatrixXf::Zero(100, 10);
+    for (int i = 0; i < num_iters; i++){
+        mnist.next_train(X, t, true);
+        net.train_step(X, t, 0.1);
+    }
+
+    QuantizedTwoLayerNet qnet(net);
+    cout << "int8 kernel: " << quantized_kernel_isa() << endl;
+
+    Map<const ImageMatrixXf> images = mnist.test_images();
+    Map<const ImageMatrixXu8> raw_images = mnist.test_images_raw();
+    Map<const LabelVectorXi> labels = mnist.test_labels();
+    const Index n = labels.size() / batch_size * batch_size;
+
+    VectorXi float_pred(n), int8_pred(n);
+    TwoLayerNetF::InferenceWorkspace ws;
+    QuantizedInferenceWorkspace qws;
+    MatrixXf batch(batch_size, 28 * 28);
+
+    // float：行優先の画像を列優先の入力行列に写す時間も含める
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++){
+        for (Index i = 0; i < n; i += batch_size){
+            batch = images.middleRows(i, batch_size);
+            net.infer_argmax(batch, float_pred.segment(i, batch_size), ws);
+        }
+    }
+    double float_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+    // int8：生の画素値をそのまま入力(変換なし)
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++){
+        for (Index i = 0; i < n; i += batch_size){
+            qnet.infer_argmax(raw_images.middleRows(i, batch_size), int8_pred.segment(i, batch_size), qws);
+        }
+    }
+    double int8_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+    double float_accuracy = (float_pred.array() == labels.head(n).array()).cast<double>().mean();
+    double int8_accuracy = (int8_pred.array() == labels.head(n).array()).cast<double>().mean();
+    double agreement = (float_pred.array() == int8_pred.array()).cast<double>().mean();
+
+    cout << "float: accuracy " << float_accuracy << ", " << n / float_seconds << " images/s" << endl;
+    cout << "int8 : accuracy " << int8_accuracy << ", " << n / int8_seconds << " images/s" << endl;
+    cout << "prediction agreement: " << agreement << endl;
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/single_image_net.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 1画像ずつの推論のレイテンシを、動的サイズ行列の経路(net.infer)と行列ベクトル積の経路(SingleImageTwoLayerNet)で比較する
+//   使い方：bench_single_image_inference [学習ステップ数(既定1000)]
+// どちらも生の画素値から予測ラベルが出るまで(正規化・softmax込み)の時間を1画像ごとに測る。
+// -DEIGEN_RUNTIME_NO_MALLOC でビルドすると、classify の間にEigenのメモリ確保がないことも確認する。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+    typedef std::chrono::steady_clock Clock;
+
+    int num_iters = argc > 1 ? std::atoi(argv[1]) : 1000;
+
+    // 学習(double)
+    MnistEigenDataset mnist(100);
+    TwoLayerNet net(28 * 28, 100, 10, 0.01);
+    MatrixXd X = MatrixXd::Zero(100, 28 * 28);
+    MatrixXd t = MatrixXd::Zero(100, 10);
+    for (int i = 0; i < num_iters; i++){
+        mnist.next_train(X, t, true);
+        net.train_step(X, t, 0.1);
+    }
+
+    SingleImageTwoLayerNet single(net);
+    if (!single.ok()){
+        cout << "network is too large for SingleImageTwoLayerNet" << endl;
+        return 1;
+    }
+    cout << "gemv kernel: " << single_image_kernel_isa() << endl;
+
+    Map<const ImageMatrixXu8> images = mnist.test_images_raw();
+    Map<const LabelVectorXi> labels = mnist.test_labels();
+    const int n = (int)labels.size();
+
+    std::vector<double> matrix_us(n), gemv_us(n);
+    VectorXi matrix_pred(n), gemv_pred(n);
+    float probabilities[10];
+
+    // 動的サイズ行列の経路
+    MatrixXd x(1, 28 * 28);
+    for (int i = 0; i < n; i++){
+        auto start = Clock::now();
+        x = images.row(i).cast<double>() / 255.0;
+        const MatrixXd &y = net.infer(x);
+        Index label;
+        y.row(0).maxCoeff(&label);
+        matrix_pred(i) = (int)label;
+        matrix_us[i] = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    // 行列ベクトル積の経路
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+    Eigen::internal::set_is_malloc_allowed(false);
+#endif
+    for (int i = 0; i < n; i++){
+        auto start = Clock::now();
+        gemv_pred(i) = single.classify(images.row(i).data(), probabilities);
+        gemv_us[i] = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+    Eigen::internal::set_is_malloc_allowed(true);
+#endif
+
+    auto report = [&](const char *name, std::vector<double> &us, const VectorXi &pred){
+        std::sort(us.begin(), us.end());
+        double accuracy = (pred.array() == labels.array()).cast<double>().mean();
+        cout << name << ": p50 " << us[n / 2] << " us, p99 " << us[n * 99 / 100] << " us, accuracy " << accuracy << endl;
+    };
+    report("matrix (net.infer)          ", matrix_us, matrix_pred);
+    report("gemv (SingleImageTwoLayerNet)", gemv_us, gemv_pred);
+    cout << "prediction agreement: " << (matrix_pred.array() == gemv_pred.array()).cast<double>().mean() << endl;
+
+    return 0;
+}
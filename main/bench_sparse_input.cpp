@@ -0,0 +1,67 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 1層目の入力を CSR 形式(非0の画素のみ)で渡した場合と、密行列で渡した場合の学習ステップの時間を比較する
+//   使い方：bench_sparse_input [学習ステップ数(既定500)] [バッチサイズ(既定100)]
+// 同じ初期値・同じバッチで学習し、勾配とパラメータが(丸め誤差の範囲で)一致することも確認する。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+    typedef std::chrono::steady_clock Clock;
+
+    int num_iters = argc > 1 ? std::atoi(argv[1]) : 500;
+    int batch_size = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    MnistEigenDataset dense_loader(batch_size);
+    MnistEigenDataset sparse_loader(batch_size);
+    MatrixXd X = MatrixXd::Zero(batch_size, 28 * 28);
+    MatrixXd t = MatrixXd::Zero(batch_size, 10);
+    MatrixXd t_sparse = MatrixXd::Zero(batch_size, 10);
+    SparseImageBatchXd X_sparse;
+
+    TwoLayerNet dense_net(28 * 28, 100, 10, 0.01);
+    TwoLayerNet sparse_net(28 * 28, 100, 10, 0);
+    sparse_net.params.flat() = dense_net.params.flat();
+
+    // 勾配の一致確認(同じバッチ)
+    dense_loader.next_train(X, t, true);
+    sparse_loader.next_train(X_sparse, t_sparse, true);
+    cout << "batch density: " << X_sparse.density() << endl;
+    double grad_diff = (dense_net.gradient(X, t).flat() - sparse_net.gradient(X_sparse, t_sparse).flat()).cwiseAbs().maxCoeff();
+    double threshold = sparse_net.sparse_density_threshold();
+    sparse_net.set_sparse_density_threshold(0); // 密行列へのフォールバック
+    double fallback_diff = (dense_net.gradient(X, t).flat() - sparse_net.gradient(X_sparse, t_sparse).flat()).cwiseAbs().maxCoeff();
+    sparse_net.set_sparse_density_threshold(threshold);
+    cout << "max gradient difference: sparse " << grad_diff << ", dense fallback " << fallback_diff << endl;
+
+    double dense_seconds = 0, sparse_seconds = 0, total_density = 0;
+    for (int i = 0; i < num_iters; i++){
+        dense_loader.next_train(X, t, true);
+        sparse_loader.next_train(X_sparse, t_sparse, true);
+        total_density += X_sparse.density();
+
+        auto start = Clock::now();
+        dense_net.train_step(X, t, 0.1);
+        dense_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        sparse_net.train_step(X_sparse, t_sparse, 0.1);
+        sparse_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double param_diff = (dense_net.params.flat() - sparse_net.params.flat()).cwiseAbs().maxCoeff();
+    cout << "mean density: " << total_density / num_iters << endl;
+    cout << "dense : " << dense_seconds / num_iters * 1e6 << " us/step" << endl;
+    cout << "sparse: " << sparse_seconds / num_iters * 1e6 << " us/step" << endl;
+    cout << "max parameter difference after " << num_iters << " steps: " << param_diff << endl;
+
+    return 0;
+}
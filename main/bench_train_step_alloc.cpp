@@ -0,0 +1,163 @@
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/optimizer.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 学習ステップ(順伝播・逆伝播・更新)と推論が、作業領域の確保後(ウォームアップ後)にヒープ確保を一切しないことを確認する
+//   使い方：bench_train_step_alloc [計測するステップ数(既定200)] [バッチサイズ(既定100)]
+// malloc 系の関数を差し替えて呼び出し回数を数える(operator new や Eigen の確保も最終的に malloc を通るので全て数えられる)。
+// 計測区間はバッチの読み出しを含まない。1回でも確保があれば、その経路を表示して終了コード1で終わる。
+// (差し替えは glibc の __libc_* を呼ぶので Linux(glibc)専用)
+
+namespace {
+    std::atomic<bool> g_counting(false);
+    std::atomic<long> g_allocations(0);
+
+    inline void count_allocation(void)
+    {
+        if (g_counting.load(std::memory_order_relaxed)){
+            g_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+    void *__libc_malloc(size_t);
+    void *__libc_calloc(size_t, size_t);
+    void *__libc_realloc(void *, size_t);
+    void *__libc_memalign(size_t, size_t);
+
+    void *malloc(size_t size)
+    {
+        count_allocation();
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t n, size_t size)
+    {
+        count_allocation();
+        return __libc_calloc(n, size);
+    }
+
+    void *realloc(void *p, size_t size)
+    {
+        count_allocation();
+        return __libc_realloc(p, size);
+    }
+
+    int posix_memalign(void **p, size_t alignment, size_t size)
+    {
+        count_allocation();
+        *p = __libc_memalign(alignment, size);
+        return *p ? 0 : ENOMEM;
+    }
+
+    void *aligned_alloc(size_t alignment, size_t size)
+    {
+        count_allocation();
+        return __libc_memalign(alignment, size);
+    }
+}
+#endif
+
+// ウォームアップとして全バッチで1回ずつ step を呼んだ後、同じバッチを順に num_iters 回 step に渡して確保回数を数える
+template <typename Batch, typename Step>
+static long count_allocations(const std::vector<Batch> &batches, int num_iters, Step step)
+{
+    for (const auto &b : batches){
+        step(b);
+    }
+
+    g_allocations = 0;
+    g_counting = true;
+    for (int i = 0; i < num_iters; i++){
+        step(batches[i % batches.size()]);
+    }
+    g_counting = false;
+    return g_allocations;
+}
+
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+
+#if !defined(__GLIBC__)
+    cout << "malloc hook requires glibc; skipped" << endl;
+    return 0;
+#endif
+
+    int num_iters = argc > 1 ? std::atoi(argv[1]) : 200;
+    int batch_size = argc > 2 ? std::atoi(argv[2]) : 100;
+    const int NUM_BATCHES = 8;
+    const int PIXELS = 28 * 28;
+
+    // バッチは先に読み出しておく(ローダの確保は計測しない)
+    struct DenseBatch{ MatrixXd X, t; MatrixXf Xf, tf; };
+    struct SparseBatch{ SparseImageBatchXd X; MatrixXd t; };
+    MnistEigenDataset mnist(batch_size);
+    std::vector<DenseBatch> dense(NUM_BATCHES);
+    std::vector<SparseBatch> sparse(NUM_BATCHES);
+    for (int i = 0; i < NUM_BATCHES; i++){
+        dense[i].X = MatrixXd::Zero(batch_size, PIXELS);
+        dense[i].t = MatrixXd::Zero(batch_size, 10);
+        mnist.next_train(dense[i].X, dense[i].t, true);
+        dense[i].Xf = dense[i].X.cast<float>();
+        dense[i].tf = dense[i].t.cast<float>();
+        sparse[i].t = MatrixXd::Zero(batch_size, 10);
+        mnist.next_train(sparse[i].X, sparse[i].t, true);
+    }
+
+    OptimizerConfig adam_config;
+    adam_config.type = OptimizerType::Adam;
+    adam_config.learning_rate = 0.001;
+    OptimizerConfig momentum_config;
+    momentum_config.type = OptimizerType::Momentum;
+    momentum_config.learning_rate = 0.05;
+
+    TwoLayerNet net(PIXELS, 100, 10, 0.01);
+    TwoLayerNet sparse_net(PIXELS, 100, 10, 0.01);
+    BasicTwoLayerNet<float> net_f(PIXELS, 100, 10, 0.01);
+    BasicTwoLayerNet<double, 28 * 28, 100, 10, Dynamic> fixed_net(0.01);
+    Optimizer adam(adam_config);
+    OptimizerF momentum(momentum_config);
+    TwoLayerNet::InferenceWorkspace infer_ws;
+
+    // 差し替えが効いていることの確認(確保するステップで数えられなければ計測自体が無効)
+    long probe = count_allocations(dense, 1, [](const DenseBatch &b){ MatrixXd tmp = b.X * 2; (void)tmp; });
+    if (probe == 0){
+        cout << "FAILED: malloc hook is not active" << endl;
+        return 1;
+    }
+
+    struct Case{ std::string name; long allocations; };
+    std::vector<Case> cases;
+    cases.push_back({"double train_step(SGD)", count_allocations(dense, num_iters, [&](const DenseBatch &b){ net.train_step(b.X, b.t, 0.05); })});
+    cases.push_back({"double train_step(Adam)", count_allocations(dense, num_iters, [&](const DenseBatch &b){ net.train_step(b.X, b.t, adam); })});
+    cases.push_back({"float train_step(Momentum)", count_allocations(dense, num_iters, [&](const DenseBatch &b){ net_f.train_step(b.Xf, b.tf, momentum); })});
+    cases.push_back({"fixed-dim train_step(SGD)", count_allocations(dense, num_iters, [&](const DenseBatch &b){ fixed_net.train_step(b.X, b.t, 0.05); })});
+    cases.push_back({"sparse train_step(SGD)", count_allocations(sparse, num_iters, [&](const SparseBatch &b){ sparse_net.train_step(b.X, b.t, 0.05); })});
+    cases.push_back({"infer(workspace)", count_allocations(dense, num_iters, [&](const DenseBatch &b){ net.infer(b.X, infer_ws); })});
+
+    int failed = 0;
+    for (const auto &c : cases){
+        cout << c.name << ": " << c.allocations << " allocations in " << num_iters << " steps" << endl;
+        failed += c.allocations != 0;
+    }
+    if (failed > 0){
+        cout << "FAILED: heap allocation after warm-up" << endl;
+        return 1;
+    }
+    cout << "OK: no heap allocation after warm-up" << endl;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/evaluator.h"
+#include "../include/model_file.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 保存したモデルファイルを mmap して、そのまま推論に使う
+//   使い方：serve_mnist_model [モデルファイル(既定 mnist_two_layer_net.model)]
+// モデルを開いてから最初の推論結果が出るまでの時間と、テストデータ全件の精度を表示する。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+
+    string path = argc > 1 ? argv[1] : "mnist_two_layer_net.model";
+
+    auto start = std::chrono::steady_clock::now();
+    MappedModel model;
+    if (!model.open(path)){
+        cout << "failed to open model: " << path << endl;
+        return 1;
+    }
+    if (model.header().dtype != (uint32_t)ModelDType::Float64){
+        cout << "this sample expects a double model" << endl;
+        return 1;
+    }
+    const ModelHeader &header = model.header();
+    TwoLayerNet net(header.input_size, header.hidden_size, header.output_size, 0);
+    if (!attach_model(model, net)){
+        cout << "model does not match the network" << endl;
+        return 1;
+    }
+    MatrixXd x = MatrixXd::Zero(1, header.input_size);
+    const MatrixXd &y = net.infer(x);
+    double startup = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    cout << "model: " << header.input_size << "-" << header.hidden_size << "-" << header.output_size
+         << ", startup to first inference: " << startup * 1e6 << " us (output sum " << y.sum() << ")" << endl;
+
+    MnistEigenDataset mnist(100);
+    Evaluator evaluator;
+    cout << "test accuracy: " << evaluator.evaluate_test(net, mnist).accuracy() << endl;
+
+    return 0;
+}
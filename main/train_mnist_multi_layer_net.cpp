@@ -0,0 +1,60 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/multi_layer_net.h"
+#include "../include/optimizer.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 多層ネットワーク(784 → 256 → 128 → 10, ReLU)の学習サンプル
+int main()
+{
+    using std::cout;
+    using std::endl;
+    using std::vector;
+    using namespace MyDL;
+
+    // ハイパーパラメータ
+    int num_iters = 3000;
+    double learning_rate = 0.001;
+    int batch_size = 100;
+    int input_size = 28 * 28;
+    vector<int> hidden_sizes = {256, 128};
+    int output_size = 10;
+
+    // MNISTデータローダ
+    MnistEigenDataset mnist(batch_size);
+
+    MatrixXd train_X = MatrixXd::Zero(batch_size, input_size);
+    MatrixXd train_y = MatrixXd::Zero(batch_size, output_size);
+    MatrixXd test_X = MatrixXd::Zero(batch_size, input_size);
+    MatrixXd test_y = MatrixXd::Zero(batch_size, output_size);
+
+    // ネットワーク生成(Affine → ReLU は1層に融合される)
+    MultiLayerNet net(input_size, hidden_sizes, output_size, LayerType::Relu, 0.05);
+    if (!net.ok()){
+        cout << "invalid network configuration" << endl;
+        return 1;
+    }
+
+    // 最適化手法(Adam)
+    OptimizerConfig config;
+    config.type = OptimizerType::Adam;
+    config.learning_rate = learning_rate;
+    Optimizer optimizer(config);
+
+    for (int i = 0; i < num_iters; i++){
+        mnist.next_train(train_X, train_y, true);
+        TrainStepResult step = net.train_step(train_X, train_y, optimizer);
+
+        // 100step毎にテストデータ1バッチ分の精度を表示
+        if (i % 100 == 0){
+            mnist.next_test(test_X, test_y, true);
+            cout << "iteration" << i << " loss: " << step.loss << " test accuracy: " << net.accuracy(test_X, test_y) << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <Eigen/Dense>
+#include "../include/two_layer_net.h"
+#include "../include/evaluator.h"
+#include "../include/ring_allreduce.h"
+#include "../include/multi_process_trainer.h"
+#include "../datasets/include/mnist.h"
+
+using namespace Eigen;
+
+// 複数プロセスでのデータ並列学習(プロセス間はUnixドメインソケットのリング all-reduce)
+//   使い方：train_mnist_multi_process [プロセス数(既定4)] [ステップ数(既定2000)] [通信を逆伝播と重ねるか(既定1)]
+// 各プロセスは別シードのデータローダから batch_size 件ずつ読むので、実効バッチサイズは プロセス数 × batch_size。
+int main(int argc, char **argv)
+{
+    using std::cout;
+    using std::endl;
+    using namespace MyDL;
+
+    int num_procs = argc > 1 ? std::atoi(argv[1]) : 4;
+    int num_iters = argc > 2 ? std::atoi(argv[2]) : 2000;
+    bool overlap = argc > 3 ? std::atoi(argv[3]) != 0 : true;
+    const int batch_size = 100;
+    const double learning_rate = 0.1;
+
+    bool ok = launch_ring_processes(num_procs, [&](RingAllReduce &ring){
+        MnistEigenDataset mnist(batch_size, true, 1000 + ring.rank());
+        MatrixXd train_X = MatrixXd::Zero(batch_size, 28 * 28);
+        MatrixXd train_y = MatrixXd::Zero(batch_size, 10);
+
+        TwoLayerNet net(28 * 28, 100, 10, 0.01);
+        MultiProcessTrainer trainer(net, ring, overlap);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_iters; i++){
+            mnist.next_train(train_X, train_y, true);
+            TrainStepResult result = trainer.train_step(train_X, train_y, learning_rate);
+            if (ring.rank() == 0 && i % 100 == 0){
+                cout << "step " << i << " loss: " << result.loss << " accuracy: " << result.accuracy << endl;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!trainer.ok()){
+            std::cerr << "rank " << ring.rank() << ": communication failed" << endl;
+            return 1;
+        }
+
+        // 全プロセスのパラメータが一致していることの確認用
+        cout << "rank " << ring.rank() << " params checksum: " << net.params.flat().sum() << endl;
+
+        if (ring.rank() == 0){
+            Evaluator evaluator;
+            EvaluationResult eval_result = evaluator.evaluate_test(net, mnist);
+            cout << num_procs << " processes (overlap=" << overlap << "): " << seconds / num_iters * 1e3 << " ms/step, test accuracy: " << eval_result.accuracy() << endl;
+        }
+        return 0;
+    });
+
+    return ok ? 0 : 1;
+}
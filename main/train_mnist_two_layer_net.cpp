@@ -1,16 +1,21 @@
 #include <map>
+#include <chrono>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <Eigen/Dense>
 #include "../include/two_layer_net.h"
+#include "../include/evaluator.h"
+#include "../include/model_file.h"
+#include "../include/optimizer.h"
+#include "../include/checkpoint.h"
 #include "../datasets/include/mnist.h"
 #include "../matplotlibcpp.h"
 
 using namespace Eigen;
 namespace plt = matplotlibcpp;
 
-int main()
+int main(int argc, char **argv)
 {
     using std::cout;
     using std::endl;
@@ -26,6 +31,8 @@ int main()
     int input_size = 28 * 28;
     int hidden_size = 100;
     int output_size = 10;
+    int checkpoint_interval = 100;
+    bool resume = argc > 1 && string(argv[1]) == "--resume"; // --resume を指定した場合のみ、前回のチェックポイントの続きから学習する
 
     // MNISTデータローダ
     MnistEigenDataset mnist(batch_size);
@@ -33,55 +40,102 @@ int main()
     // 各種変数初期化
     MatrixXd train_X = MatrixXd::Zero(batch_size, input_size);
     MatrixXd train_y = MatrixXd::Zero(batch_size, output_size);
-    MatrixXd test_X = MatrixXd::Zero(batch_size, input_size);
-    MatrixXd test_y = MatrixXd::Zero(batch_size, output_size);
     bool one_hot_label = true;
 
     // ネットワーク生成
     TwoLayerNet net(input_size, hidden_size, output_size, 0.01);
 
+    // テストデータ全件評価用
+    Evaluator evaluator;
+    EvaluationResult eval_result;
+
     // 最適化用
-    map<string, MatrixXd> grads;
     double loss;
     double accuracy;
-
-    // 学習経過プロット用
-    vector<double> loss_history(num_iters);
-    vector<int> plot_counter(num_iters);
-    vector<double> accuracy_history(num_iters / 10);
-    vector<int> accuracy_counter(num_iters / 10);
+    OptimizerConfig optimizer_config;
+    optimizer_config.type = OptimizerType::SGD;
+    optimizer_config.learning_rate = learning_rate;
+    Optimizer optimizer(optimizer_config);
+
+    // チェックポイント：--resume のときはパラメータ・最適化手法の状態・ローダの読み出し位置を復元して再開する
+    // (チェックポイントにはハイパーパラメータを保存していないので、同じ設定で再開すること)
+    AsyncCheckpointer checkpointer("mnist_two_layer_net.ckpt");
+    long resume_step = -1;
+    if (resume){
+        if (!AsyncCheckpointer::load(checkpointer.path(), resume_step, net.params, &optimizer, &mnist)){
+            cout << "failed to load checkpoint " << checkpointer.path() << endl;
+            return 1;
+        }
+        cout << "resumed from checkpoint at iteration " << resume_step << endl;
+        if (resume_step + 1 >= num_iters){
+            cout << "checkpoint has already finished " << num_iters << " iterations; nothing to train" << endl;
+            return 0;
+        }
+    }
+    double max_checkpoint_pause = 0; // save で学習ループが止まった時間の最大値
+
+    // 学習経過プロット用(再開した場合は、この実行で学習した分だけ)
+    vector<double> loss_history;
+    vector<int> plot_counter;
+    vector<double> accuracy_history;
+    vector<int> accuracy_counter;
+    loss_history.reserve(num_iters);
+    plot_counter.reserve(num_iters);
+    accuracy_history.reserve(num_iters / 10 + 1);
+    accuracy_counter.reserve(num_iters / 10 + 1);
 
     // 最適化実行
-    for (int i = 0; i < num_iters; i++){
+    for (int i = (int)resume_step + 1; i < num_iters; i++){
         // 次のミニバッチ取得
         mnist.next_train(train_X, train_y, one_hot_label);
         
-        // 勾配計算
-        grads = net.gradient(train_X, train_y); // 内部で
-        
-        // 勾配更新
-        for (auto i = grads.begin(); i != grads.end(); i++){
-            net.params[i->first] -= learning_rate * grads[i->first];
-        }
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+        // 確認用：-DEIGEN_RUNTIME_NO_MALLOC でビルドすると、2step目以降の学習ステップで
+        // Eigenのメモリ確保が1回でも発生した時点でassertで停止する
+        Eigen::internal::set_is_malloc_allowed(i == resume_step + 1);
+#endif
+
+        // 勾配計算・更新(損失も同じ順伝播の結果から計算される：更新前のパラメータでの値)
+        TrainStepResult step = net.train_step(train_X, train_y, optimizer);
+
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+        Eigen::internal::set_is_malloc_allowed(true);
+#endif
 
         // 損失プロット用
-        loss = net.loss(train_X, train_y);
-        loss_history[i] = loss;
-        plot_counter[i] = i;
+        loss = step.loss;
+        loss_history.push_back(loss);
+        plot_counter.push_back(i);
 
         cout << "iteration" << i << " loss: " << loss << endl;
 
-        // 10step毎にaccuracy計測
+        // 10step毎にaccuracy計測(テストデータ全件)
         if (i % 10 == 0){
-            mnist.next_test(test_X, test_y, one_hot_label);
-            accuracy = net.accuracy(test_X, test_y);
+            eval_result = evaluator.evaluate_test(net, mnist);
+            accuracy = eval_result.accuracy();
 
             cout << "accuracy: " << accuracy << endl;
 
-            accuracy_history[i/10] = accuracy;
-            accuracy_counter[i/10] = i / 10;
+            accuracy_history.push_back(accuracy);
+            accuracy_counter.push_back(i / 10);
+        }
+
+        // 定期的にチェックポイント(ファイルへの書き出しはバックグラウンド)
+        if ((i + 1) % checkpoint_interval == 0){
+            auto start = std::chrono::steady_clock::now();
+            checkpointer.save(i, net.params, &optimizer, &mnist);
+            max_checkpoint_pause = std::max(max_checkpoint_pause, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
         }
     }
+    if (!checkpointer.wait()){
+        cout << "failed to write checkpoint" << endl;
+    }
+    cout << "checkpoint: last written iteration " << checkpointer.written_step() << ", max pause " << max_checkpoint_pause * 1e3 << " ms" << endl;
+
+    // 学習済みモデルの保存("main/serve_mnist_model.cpp" で mmap して推論できる)
+    if (!save_model("mnist_two_layer_net.model", net)){
+        cout << "failed to save model" << endl;
+    }
 
     // visualize
     plt::title("Loss History");